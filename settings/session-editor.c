@@ -328,26 +328,24 @@ session_editor_set_from_desktop_file(GtkTreeModel *model,
     xfce_rc_close(rcfile);
 }
 
+typedef struct
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+} PropertyChangeData;
+
 static void
-client_sm_property_changed(DBusGProxy *proxy,
-                           const gchar *name,
-                           const GValue *value,
+client_sm_property_changed(gpointer key,
+                           gpointer value_p,
                            gpointer user_data)
 {
-    GtkTreeView *treeview = user_data;
-    GtkTreeModel *model = gtk_tree_view_get_model(treeview);
-    GtkTreeRowReference *rref = g_object_get_data(G_OBJECT(proxy),
-                                                  TREE_ROW_REF_KEY);
-    GtkTreePath *path = gtk_tree_row_reference_get_path(rref);
-    GtkTreeIter iter;
+    const gchar *name = key;
+    const GValue *value = value_p;
+    PropertyChangeData *pdata = user_data;
+    GtkTreeModel *model = pdata->model;
+    GtkTreeIter iter = pdata->iter;
     gboolean has_desktop_file = FALSE;
 
-    if(!gtk_tree_model_get_iter(model, &iter, path)) {
-        gtk_tree_path_free(path);
-        return;
-    }
-    gtk_tree_path_free(path);
-
     gtk_tree_model_get(model, &iter,
                        COL_HAS_DESKTOP_FILE, &has_desktop_file,
                        -1);
@@ -382,6 +380,27 @@ client_sm_property_changed(DBusGProxy *proxy,
     }
 }
 
+static void
+client_sm_properties_changed(DBusGProxy *proxy,
+                             GHashTable *properties,
+                             gpointer user_data)
+{
+    GtkTreeView *treeview = user_data;
+    GtkTreeRowReference *rref = g_object_get_data(G_OBJECT(proxy),
+                                                  TREE_ROW_REF_KEY);
+    GtkTreePath *path = gtk_tree_row_reference_get_path(rref);
+    PropertyChangeData pdata;
+
+    pdata.model = gtk_tree_view_get_model(treeview);
+    if(!gtk_tree_model_get_iter(pdata.model, &pdata.iter, path)) {
+        gtk_tree_path_free(path);
+        return;
+    }
+    gtk_tree_path_free(path);
+
+    g_hash_table_foreach(properties, client_sm_property_changed, &pdata);
+}
+
 static void
 client_state_changed(DBusGProxy *proxy,
                      guint old_state,
@@ -483,11 +502,13 @@ manager_client_registered(DBusGProxy *proxy,
                            (GDestroyNotify)gtk_tree_row_reference_free);
     gtk_tree_path_free(path);
 
-    dbus_g_proxy_add_signal(client_proxy, "SmPropertyChanged",
-                            G_TYPE_STRING, G_TYPE_VALUE,
+    dbus_g_proxy_add_signal(client_proxy, "SmPropertiesChanged",
+                            dbus_g_type_get_map("GHashTable",
+                                                G_TYPE_STRING,
+                                                G_TYPE_VALUE),
                             G_TYPE_INVALID);
-    dbus_g_proxy_connect_signal(client_proxy, "SmPropertyChanged",
-                                G_CALLBACK(client_sm_property_changed),
+    dbus_g_proxy_connect_signal(client_proxy, "SmPropertiesChanged",
+                                G_CALLBACK(client_sm_properties_changed),
                                 treeview, NULL);
 
     /* proxy will live as long as the client does */
@@ -771,9 +792,12 @@ session_editor_init(GtkBuilder *builder)
     dbus_g_object_register_marshaller(g_cclosure_marshal_VOID__STRING,
                                       G_TYPE_NONE, G_TYPE_STRING,
                                       G_TYPE_INVALID);
-    dbus_g_object_register_marshaller(xfce4_session_marshal_VOID__STRING_BOXED,
-                                      G_TYPE_NONE, G_TYPE_STRING,
-                                      G_TYPE_VALUE, G_TYPE_INVALID);
+    dbus_g_object_register_marshaller(g_cclosure_marshal_VOID__BOXED,
+                                      G_TYPE_NONE,
+                                      dbus_g_type_get_map("GHashTable",
+                                                          G_TYPE_STRING,
+                                                          G_TYPE_VALUE),
+                                      G_TYPE_INVALID);
     dbus_g_object_register_marshaller(xfce4_session_marshal_VOID__UINT_UINT,
                                       G_TYPE_NONE, G_TYPE_UINT, G_TYPE_UINT,
                                       G_TYPE_INVALID);
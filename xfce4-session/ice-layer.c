@@ -49,13 +49,18 @@
 #include <libxfce4util/libxfce4util.h>
 
 #include <xfce4-session/ice-layer.h>
+#include <xfce4-session/xfsm-deadline.h>
 #include <xfce4-session/xfsm-global.h>
 #include <xfce4-session/xfsm-manager.h>
 
+/* how long a new connection may take for the ICE connection setup */
+#define ICE_HANDSHAKE_TIMEOUT (10 * 1000)
+
 typedef struct
 {
   XfsmManager *manager;
   IceConn ice_conn;
+  guint handshake_id;     /* deadline, 0 once the connection was accepted */
 } XfsmIceConnData;
 
 
@@ -100,6 +105,74 @@ ice_error_handler (IceConn ice_conn)
 }
 
 
+static void
+ice_conn_data_free (XfsmIceConnData *icdata)
+{
+  if (icdata->handshake_id != 0)
+    xfsm_deadline_remove (icdata->handshake_id);
+
+  g_free (icdata);
+}
+
+
+static void
+ice_connection_reject (IceConn ice_conn)
+{
+  IceSetShutdownNegotiation (ice_conn, False);
+  IceCloseConnection (ice_conn);
+}
+
+
+static gboolean
+ice_handshake_timeout (gpointer user_data)
+{
+  XfsmIceConnData *icdata = user_data;
+
+  icdata->handshake_id = 0;
+
+  g_warning ("ICE connection %p did not finish the connection setup "
+             "within %d seconds, closing it", (gpointer) icdata->ice_conn,
+             ICE_HANDSHAKE_TIMEOUT / 1000);
+
+  /* removes the I/O watch, which frees icdata */
+  ice_connection_reject (icdata->ice_conn);
+
+  return FALSE;
+}
+
+
+/* one step of the connection setup of a new connection, with the
+ * messages that were available, see ice_connection_accept() */
+static gboolean
+ice_handshake_process (XfsmIceConnData *icdata)
+{
+  IceConnectStatus cstatus;
+
+  cstatus = IceConnectionStatus (icdata->ice_conn);
+  if (cstatus == IceConnectPending)
+    return TRUE;
+
+  xfsm_deadline_remove (icdata->handshake_id);
+  icdata->handshake_id = 0;
+
+  if (cstatus == IceConnectAccepted)
+    {
+      xfsm_verbose ("ICE connection fd = %d, connection setup done\n",
+                    IceConnectionNumber (icdata->ice_conn));
+      return TRUE;
+    }
+
+  if (cstatus == IceConnectIOError)
+    g_warning ("I/O error opening ICE connection %p", (gpointer) icdata->ice_conn);
+  else
+    g_warning ("ICE connection %p rejected", (gpointer) icdata->ice_conn);
+
+  ice_connection_reject (icdata->ice_conn);
+
+  return FALSE;
+}
+
+
 static gboolean
 ice_process_messages (GIOChannel  *channel,
                       GIOCondition condition,
@@ -119,6 +192,10 @@ ice_process_messages (GIOChannel  *channel,
       return FALSE;
     }
 
+  /* still in the connection setup, there is no client for it yet */
+  if (icdata->handshake_id != 0)
+    return ice_handshake_process (icdata);
+
   /* keep the I/O watch running */
   return TRUE;
 }
@@ -141,6 +218,16 @@ ice_connection_watch (IceConn     ice_conn,
       XfsmIceConnData *icdata = g_new(XfsmIceConnData, 1);
       icdata->manager = manager;
       icdata->ice_conn = ice_conn;
+      icdata->handshake_id = 0;
+
+      /* IceAcceptConnection() calls us before the peer said anything,
+       * the connection setup is driven by the I/O watch below */
+      if (IceConnectionStatus (ice_conn) == IceConnectPending)
+        {
+          icdata->handshake_id = xfsm_deadline_add_seconds (ICE_HANDSHAKE_TIMEOUT / 1000,
+                                                            ice_handshake_timeout,
+                                                            icdata);
+        }
 
       fd = IceConnectionNumber (ice_conn);
 
@@ -157,7 +244,7 @@ ice_connection_watch (IceConn     ice_conn,
       watchid = g_io_add_watch_full (channel, G_PRIORITY_DEFAULT,
                                      G_IO_ERR | G_IO_HUP | G_IO_IN,
                                      ice_process_messages,
-                                     icdata, (GDestroyNotify) g_free);
+                                     icdata, (GDestroyNotify) ice_conn_data_free);
       g_io_channel_unref (channel);
 
       *watch_data = (IcePointer) GUINT_TO_POINTER (watchid);
@@ -170,12 +257,17 @@ ice_connection_watch (IceConn     ice_conn,
 }
 
 
+/* Accepting only creates the connection, the connection setup is
+ * done by ice_process_messages() as the messages of the peer come in,
+ * so a slow or broken client cannot block the manager (and the other
+ * clients connecting at the same time, e.g. during session restore),
+ * and is dropped after ICE_HANDSHAKE_TIMEOUT.
+ */
 static gboolean
 ice_connection_accept (GIOChannel  *channel,
                        GIOCondition condition,
                        gpointer     watch_data)
 {
-  IceConnectStatus cstatus;
   IceAcceptStatus  astatus;
   IceListenObj     ice_listener = (IceListenObj) watch_data;
   IceConn          ice_conn;
@@ -189,27 +281,8 @@ ice_connection_accept (GIOChannel  *channel,
     }
   else
     {
-      /* Wait for the connection to leave pending state */
-      do
-        {
-          IceProcessMessages (ice_conn, NULL, NULL);
-        }
-      while ((cstatus = IceConnectionStatus (ice_conn)) == IceConnectPending);
-
-      if (cstatus != IceConnectAccepted)
-        {
-          if (cstatus == IceConnectIOError)
-            {
-              g_warning ("I/O error opening ICE connection %p", (gpointer) ice_conn);
-            }
-          else
-            {
-              g_warning ("ICE connection %p rejected", (gpointer) ice_conn);
-            }
-
-          IceSetShutdownNegotiation (ice_conn, False);
-          IceCloseConnection (ice_conn);
-        }
+      xfsm_verbose ("ICE connection fd = %d, accepted, waiting for the "
+                    "connection setup\n", IceConnectionNumber (ice_conn));
     }
 
   return TRUE;
@@ -61,8 +61,10 @@
 
 #include <xfce4-session/ice-layer.h>
 #include <xfce4-session/sm-layer.h>
+#include <xfce4-session/xfsm-deadline.h>
 #include <xfce4-session/xfsm-dns.h>
 #include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-intern.h>
 #include <xfce4-session/xfsm-manager.h>
 #include <xfce4-session/xfsm-shutdown.h>
 #include <xfce4-session/xfsm-startup.h>
@@ -98,6 +100,10 @@ setup_environment (void)
   if (g_getenv ("XFSM_VERBOSE") != NULL)
     xfsm_enable_verbose ();
 
+  /* count the wakeups of the main loop while the session is idle */
+  if (g_getenv ("XFSM_COUNT_WAKEUPS") != NULL)
+    xfsm_deadline_count_wakeups ();
+
   /* pass correct DISPLAY to children, in case of --display in argv */
   g_setenv ("DISPLAY", gdk_display_get_name (gdk_display_get_default ()), TRUE);
 
@@ -243,6 +249,12 @@ main (int argc, char **argv)
   XfsmShutdown     *shutdown_helper;
   gboolean          succeed = TRUE;
 
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  /* the session file is written from a separate thread */
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
   if (!xfsm_dbus_require_session (argc, argv))
     return EXIT_SUCCESS;
 
@@ -307,6 +319,9 @@ main (int argc, char **argv)
 
   gtk_main ();
 
+  xfsm_deadline_dump_stats ();
+  xfsm_intern_dump_stats ();
+
   xfsm_startup_shutdown ();
 
   shutdown_type = xfsm_manager_get_shutdown_type (manager);
@@ -422,10 +422,6 @@ sm_get_properties (SmsConn   sms_conn,
 
   SmsReturnProperties (sms_conn, num_props, props);
 
-  if (num_props > 0)
-    {
-      while (num_props-- > 0)
-        SmFreeProperty (props[num_props]);
-      free (props);
-    }
+  /* the properties themselves stay cached */
+  free (props);
 }
@@ -35,6 +35,7 @@
 #include <xfce4-session/xfsm-client.h>
 #include <xfce4-session/xfsm-manager.h>
 #include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-intern.h>
 #include <xfce4-session/xfsm-marshal.h>
 #include <xfce4-session/xfsm-error.h>
 
@@ -46,7 +47,7 @@ struct _XfsmClient
 
   XfsmManager     *manager;
 
-  gchar           *id;
+  const gchar     *id;            /* interned */
   gchar           *object_path;
 
   XfsmClientState  state;
@@ -54,6 +55,11 @@ struct _XfsmClient
   SmsConn          sms_conn;
 
   DBusGConnection *dbus_conn;
+
+  /* properties changed since the last SmPropertiesChanged signal,
+   * flushed from an idle callback */
+  GHashTable      *changed_props;
+  guint            changed_props_id;
 };
 
 typedef struct _XfsmClientClass
@@ -71,6 +77,9 @@ typedef struct _XfsmClientClass
 
   void (*sm_property_deleted) (XfsmClient  *client,
                                const gchar *name);
+
+  void (*sm_properties_changed) (XfsmClient *client,
+                                 GHashTable *properties);
 } XfsmClientClass;
 
 typedef struct
@@ -84,13 +93,15 @@ enum
   SIG_STATE_CHANGED = 0,
   SIG_SM_PROPERTY_CHANGED,
   SIG_SM_PROPERTY_DELETED,
+  SIG_SM_PROPERTIES_CHANGED,
   N_SIGS
 };
 
 
 static void xfsm_client_finalize (GObject *obj);
 
-static void    xfsm_properties_discard_command_changed (XfsmProperties *properties,
+static void    xfsm_properties_discard_command_changed (XfsmClient     *client,
+                                                        XfsmProperties *properties,
                                                         gchar         **old_discard);
 static void    xfsm_client_dbus_class_init (XfsmClientClass *klass);
 static void    xfsm_client_dbus_init (XfsmClient *client);
@@ -140,6 +151,18 @@ xfsm_client_class_init (XfsmClientClass *klass)
                                                    G_TYPE_NONE, 1,
                                                    G_TYPE_STRING);
 
+  signals[SIG_SM_PROPERTIES_CHANGED] = g_signal_new ("sm-properties-changed",
+                                                     XFSM_TYPE_CLIENT,
+                                                     G_SIGNAL_RUN_LAST,
+                                                     G_STRUCT_OFFSET (XfsmClientClass,
+                                                                      sm_properties_changed),
+                                                     NULL, NULL,
+                                                     g_cclosure_marshal_VOID__BOXED,
+                                                     G_TYPE_NONE, 1,
+                                                     dbus_g_type_get_map ("GHashTable",
+                                                                          G_TYPE_STRING,
+                                                                          G_TYPE_VALUE));
+
   xfsm_client_dbus_class_init (klass);
 }
 
@@ -155,12 +178,17 @@ xfsm_client_finalize (GObject *obj)
 {
   XfsmClient *client = XFSM_CLIENT (obj);
 
+  if (client->changed_props_id != 0)
+    g_source_remove (client->changed_props_id);
+  if (client->changed_props != NULL)
+    g_hash_table_destroy (client->changed_props);
+
   xfsm_client_dbus_cleanup (client);
 
   if (client->properties != NULL)
     xfsm_properties_free (client->properties);
 
-  g_free (client->id);
+  xfsm_unintern (client->id);
   g_free (client->object_path);
 
   G_OBJECT_CLASS (xfsm_client_parent_class)->finalize (obj);
@@ -170,7 +198,8 @@ xfsm_client_finalize (GObject *obj)
 
 
 static void
-xfsm_properties_discard_command_changed (XfsmProperties *properties,
+xfsm_properties_discard_command_changed (XfsmClient     *client,
+                                         XfsmProperties *properties,
                                          gchar         **old_discard)
 {
   gchar **new_discard;
@@ -185,14 +214,47 @@ xfsm_properties_discard_command_changed (XfsmProperties *properties,
       xfsm_verbose ("Client Id = %s, running old discard command.\n\n",
                     properties->client_id);
 
-      g_spawn_sync (xfsm_properties_get_string(properties, SmCurrentDirectory),
-                    old_discard,
-                    xfsm_properties_get_strv(properties, SmEnvironment),
-                    G_SPAWN_SEARCH_PATH,
-                    NULL, NULL,
-                    NULL, NULL,
-                    NULL, NULL);
+      xfsm_manager_run_discard_command (client->manager, properties, old_discard);
+    }
+}
+
+
+static void
+xfsm_client_flush_prop_changes (XfsmClient *client)
+{
+  GHashTable *changed_props;
+
+  if (client->changed_props_id != 0)
+    {
+      g_source_remove (client->changed_props_id);
+      client->changed_props_id = 0;
     }
+
+  changed_props = client->changed_props;
+  client->changed_props = NULL;
+
+  if (changed_props != NULL)
+    {
+      if (g_hash_table_size (changed_props) > 0)
+        {
+          g_signal_emit (client, signals[SIG_SM_PROPERTIES_CHANGED], 0,
+                         changed_props);
+        }
+
+      g_hash_table_destroy (changed_props);
+    }
+}
+
+
+static gboolean
+xfsm_client_flush_prop_changes_idle (gpointer user_data)
+{
+  XfsmClient *client = XFSM_CLIENT (user_data);
+
+  client->changed_props_id = 0;
+  xfsm_client_flush_prop_changes (client);
+
+  return FALSE;
 }
 
 
@@ -201,13 +263,36 @@ xfsm_client_signal_prop_change (XfsmClient *client,
                                 const gchar *name)
 {
   const GValue   *value;
+  GValue         *copy;
   XfsmProperties *properties = client->properties;
 
   value = xfsm_properties_get (properties, name);
   if (value)
     {
-      g_signal_emit (client, signals[SIG_SM_PROPERTY_CHANGED], 0,
-                     name, value);
+      if (xfsm_manager_get_property_signals (client->manager))
+        {
+          g_signal_emit (client, signals[SIG_SM_PROPERTY_CHANGED], 0,
+                         name, value);
+        }
+
+      /* collect the changes made during this main loop iteration,
+       * listeners get them in one SmPropertiesChanged signal */
+      if (client->changed_props == NULL)
+        {
+          client->changed_props = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                         g_free,
+                                                         (GDestroyNotify) xfsm_g_value_free);
+        }
+
+      copy = xfsm_g_value_new (G_VALUE_TYPE (value));
+      g_value_copy (value, copy);
+      g_hash_table_replace (client->changed_props, g_strdup (name), copy);
+
+      if (client->changed_props_id == 0)
+        {
+          client->changed_props_id = g_idle_add (xfsm_client_flush_prop_changes_idle,
+                                                 client);
+        }
     }
 }
 
@@ -242,7 +327,8 @@ xfsm_client_set_initial_properties (XfsmClient     *client,
     xfsm_properties_free (client->properties);
   client->properties = properties;
 
-  client->id = g_strdup (properties->client_id);
+  xfsm_unintern (client->id);
+  client->id = xfsm_intern (properties->client_id);
 
   g_free (client->object_path);
   client->object_path = g_strconcat (XFSM_CLIENT_OBJECT_PATH_PREFIX,
@@ -272,6 +358,10 @@ xfsm_client_set_state (XfsmClient     *client,
   if (G_LIKELY (client->state != state))
     {
       XfsmClientState old_state = client->state;
+
+      /* deliver pending property changes before the state change */
+      xfsm_client_flush_prop_changes (client);
+
       client->state = state;
       g_signal_emit (client, signals[SIG_STATE_CHANGED], 0, old_state, state);
     }
@@ -346,7 +436,10 @@ xfsm_client_merge_properties (XfsmClient *client,
       if (xfsm_properties_set_from_smprop (properties, prop))
         {
           if (old_discard)
-            xfsm_properties_discard_command_changed (properties, old_discard);
+            xfsm_properties_discard_command_changed (client, properties, old_discard);
+
+          if (xfsm_properties_is_stored (prop->name))
+            xfsm_manager_session_changed (client->manager);
 
           xfsm_client_signal_prop_change (client, prop->name);
         }
@@ -373,6 +466,13 @@ xfsm_client_delete_properties (XfsmClient *client,
     {
       if (xfsm_properties_remove (properties, prop_names[n]))
         {
+          if (xfsm_properties_is_stored (prop_names[n]))
+            xfsm_manager_session_changed (client->manager);
+
+          /* don't report a value that no longer exists */
+          if (client->changed_props != NULL)
+            g_hash_table_remove (client->changed_props, prop_names[n]);
+
           g_signal_emit (client, signals[SIG_SM_PROPERTY_DELETED], 0,
                          prop_names[n]);
         }
@@ -479,20 +579,6 @@ xfsm_client_dbus_get_state (XfsmClient *client,
 }
 
 
-static gboolean
-xfsm_client_properties_tree_foreach (gpointer key,
-                                     gpointer value,
-                                     gpointer data)
-{
-  gchar       *prop_name = key;
-  GValue      *prop_value = value;
-  GHashTable  *hash_table = data;
-
-  g_hash_table_insert (hash_table, prop_name, prop_value);
-
-  return FALSE;
-}
-
 static gboolean
 xfsm_client_dbus_get_all_sm_properties (XfsmClient *client,
                                         GHashTable **OUT_properties,
@@ -507,11 +593,7 @@ xfsm_client_dbus_get_all_sm_properties (XfsmClient *client,
       return FALSE;
     }
 
-  *OUT_properties = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                           NULL, NULL);
-  g_tree_foreach (properties->sm_properties,
-                  xfsm_client_properties_tree_foreach,
-                  *OUT_properties);
+  *OUT_properties = xfsm_properties_get_table (properties);
 
   return TRUE;
 }
@@ -538,9 +620,9 @@ xfsm_client_dbus_get_sm_properties (XfsmClient  *client,
 
   for (i = 0; names[i]; ++i)
     {
-      GValue *value = g_tree_lookup (properties->sm_properties, names[i]);
+      const GValue *value = xfsm_properties_get (properties, names[i]);
       if (G_LIKELY (value))
-        g_hash_table_insert (*OUT_properties, names[i], value);
+        g_hash_table_insert (*OUT_properties, names[i], (gpointer) value);
     }
 
   return TRUE;
@@ -552,11 +634,17 @@ xfsm_client_dbus_merge_properties_ht (gpointer key,
                                       gpointer value,
                                       gpointer user_data)
 {
-  gchar          *prop_name = key;
-  GValue         *prop_value = value;
-  XfsmProperties *properties = user_data;
+  gchar      *prop_name = key;
+  GValue     *prop_value = value;
+  XfsmClient *client = user_data;
 
-  xfsm_properties_set (properties, prop_name, prop_value);
+  if (xfsm_properties_set (client->properties, prop_name, prop_value))
+    {
+      if (xfsm_properties_is_stored (prop_name))
+        xfsm_manager_session_changed (client->manager);
+
+      xfsm_client_signal_prop_change (client, prop_name);
+    }
 }
 
 
@@ -573,7 +661,7 @@ xfsm_client_dbus_set_sm_properties (XfsmClient *client,
     }
 
   g_hash_table_foreach (properties, xfsm_client_dbus_merge_properties_ht,
-                        client->properties);
+                        client);
 
   return TRUE;
 }
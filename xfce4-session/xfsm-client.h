@@ -47,6 +47,7 @@ typedef enum
   XFSM_CLIENT_WAITFORINTERACT,
   XFSM_CLIENT_WAITFORPHASE2,
   XFSM_CLIENT_DISCONNECTED,
+  XFSM_CLIENT_WAITFORSAVE,
 } XfsmClientState;
 
 GType xfsm_client_get_type (void) G_GNUC_CONST;
@@ -0,0 +1,471 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include <xfce4-session/xfsm-command-queue.h>
+#include <xfce4-session/xfsm-deadline.h>
+#include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-intern.h>
+
+
+/* msec between SIGTERM and SIGKILL for commands that overran */
+#define XFSM_COMMAND_KILL_TIMEOUT (2 * 1000)
+
+
+typedef struct _XfsmCommand XfsmCommand;
+
+struct _XfsmCommand
+{
+  XfsmCommandQueue *queue;
+
+  gchar            *key;
+  const gchar      *client_id;   /* interned */
+  gchar            *working_directory;
+  gchar           **command;
+  gchar           **environment;
+
+  GPid              pid;
+  guint             child_watch_id;
+  guint             deadline_id;
+  gboolean          timed_out;
+  gboolean          terminated;
+};
+
+struct _XfsmCommandQueue
+{
+  gchar              *name;
+  guint               max_running;
+  guint               timeout;      /* msec, 0 for none */
+
+  GQueue             *pending;
+  GList              *running;
+  guint               n_running;
+
+  /* key -> XfsmCommand, for both pending and running commands */
+  GHashTable         *commands;
+
+  XfsmCommandDoneFunc done_func;
+  gpointer            user_data;
+};
+
+
+static void xfsm_command_queue_run_pending (XfsmCommandQueue *queue);
+
+
+
+static gchar*
+xfsm_command_make_key (const gchar *working_directory,
+                       gchar      **command)
+{
+  GString *key;
+  gchar  **arg;
+
+  /* length prefixed, so no two different commands share a key */
+  key = g_string_new (NULL);
+  if (working_directory != NULL)
+    g_string_append_printf (key, "%u:%s", (guint) strlen (working_directory),
+                            working_directory);
+  else
+    g_string_append (key, "-");
+
+  for (arg = command; *arg != NULL; ++arg)
+    g_string_append_printf (key, "%u:%s", (guint) strlen (*arg), *arg);
+
+  return g_string_free (key, FALSE);
+}
+
+
+
+static void
+xfsm_command_reap (GPid     pid,
+                   gint     status,
+                   gpointer user_data)
+{
+  g_spawn_close_pid (pid);
+}
+
+
+
+static void
+xfsm_command_free (XfsmCommand *cmd)
+{
+  if (cmd->deadline_id != 0)
+    xfsm_deadline_remove (cmd->deadline_id);
+
+  if (cmd->child_watch_id != 0)
+    {
+      /* still running, killed by xfsm_command_queue_abort() or left
+       * alone by xfsm_command_queue_free(); nobody is told about its
+       * exit any more, but it must not stay around as a zombie */
+      g_source_remove (cmd->child_watch_id);
+      g_child_watch_add (cmd->pid, xfsm_command_reap, NULL);
+    }
+  else if (cmd->pid != 0)
+    {
+      g_spawn_close_pid (cmd->pid);
+    }
+
+  g_free (cmd->key);
+  xfsm_unintern (cmd->client_id);
+  g_free (cmd->working_directory);
+  g_strfreev (cmd->command);
+  g_strfreev (cmd->environment);
+
+  g_slice_free (XfsmCommand, cmd);
+}
+
+
+
+static void
+xfsm_command_finish (XfsmCommand *cmd,
+                     gint         exit_status)
+{
+  XfsmCommandQueue *queue = cmd->queue;
+
+  if (cmd->pid != 0)
+    {
+      queue->running = g_list_remove (queue->running, cmd);
+      queue->n_running--;
+    }
+
+  g_hash_table_remove (queue->commands, cmd->key);
+
+  if (queue->done_func != NULL)
+    {
+      queue->done_func (cmd->client_id, cmd->command, exit_status,
+                        cmd->timed_out, queue->user_data);
+    }
+
+  xfsm_command_free (cmd);
+}
+
+
+
+static void
+xfsm_command_child_watch (GPid     pid,
+                          gint     status,
+                          gpointer user_data)
+{
+  XfsmCommand      *cmd = user_data;
+  XfsmCommandQueue *queue = cmd->queue;
+  gint              exit_status;
+
+  /* the source is gone once we return */
+  cmd->child_watch_id = 0;
+
+  if (WIFEXITED (status))
+    exit_status = WEXITSTATUS (status);
+  else if (WIFSIGNALED (status))
+    exit_status = -WTERMSIG (status);
+  else
+    exit_status = G_MININT;
+
+  xfsm_verbose ("%s queue: \"%s\" for client %s exited with status %d%s\n",
+                queue->name, *cmd->command, cmd->client_id, exit_status,
+                cmd->timed_out ? " after it timed out" : "");
+
+  xfsm_command_finish (cmd, exit_status);
+  xfsm_command_queue_run_pending (queue);
+}
+
+
+
+static gboolean
+xfsm_command_timeout (gpointer user_data)
+{
+  XfsmCommand *cmd = user_data;
+
+  cmd->deadline_id = 0;
+  cmd->timed_out = TRUE;
+
+  /* the child watch reports it and frees the slot */
+  if (!cmd->terminated)
+    {
+      g_warning ("%s command \"%s\" for client %s did not exit within %u ms, "
+                 "terminating it", cmd->queue->name, *cmd->command,
+                 cmd->client_id, cmd->queue->timeout);
+
+      cmd->terminated = TRUE;
+      kill (cmd->pid, SIGTERM);
+
+      cmd->deadline_id = xfsm_deadline_add (XFSM_COMMAND_KILL_TIMEOUT,
+                                            xfsm_command_timeout,
+                                            cmd);
+    }
+  else
+    {
+      g_warning ("%s command \"%s\" for client %s ignored SIGTERM, "
+                 "killing it", cmd->queue->name, *cmd->command,
+                 cmd->client_id);
+
+      kill (cmd->pid, SIGKILL);
+    }
+
+  return FALSE;
+}
+
+
+
+static void
+xfsm_command_queue_run_pending (XfsmCommandQueue *queue)
+{
+  XfsmCommand *cmd;
+  GError      *error = NULL;
+
+  while (queue->n_running < queue->max_running
+         && (cmd = g_queue_pop_head (queue->pending)) != NULL)
+    {
+      xfsm_verbose ("%s queue: running \"%s\" for client %s "
+                    "[%u running, %u waiting]\n", queue->name, *cmd->command,
+                    cmd->client_id, queue->n_running, queue->pending->length);
+
+      if (!g_spawn_async (cmd->working_directory,
+                          cmd->command,
+                          cmd->environment,
+                          G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                          NULL, NULL,
+                          &cmd->pid,
+                          &error))
+        {
+          g_warning ("Failed to run %s command \"%s\": %s",
+                     queue->name, *cmd->command, error->message);
+          g_error_free (error);
+          error = NULL;
+
+          cmd->pid = 0;
+          xfsm_command_finish (cmd, G_MININT);
+          continue;
+        }
+
+      queue->running = g_list_prepend (queue->running, cmd);
+      queue->n_running++;
+
+      cmd->child_watch_id = g_child_watch_add (cmd->pid,
+                                               xfsm_command_child_watch,
+                                               cmd);
+
+      if (queue->timeout > 0)
+        {
+          cmd->deadline_id = xfsm_deadline_add (queue->timeout,
+                                                xfsm_command_timeout,
+                                                cmd);
+        }
+    }
+}
+
+
+
+/**
+ * xfsm_command_queue_new:
+ * @name        : used in log messages, e.g. "discard".
+ * @max_running : number of commands that may run at the same time.
+ * @timeout     : msec a command may run before it is terminated, or 0.
+ * @done_func   : called when a command finished or failed to start.
+ * @user_data   : data passed to @done_func.
+ *
+ * Return value: a new, empty command queue.
+ **/
+XfsmCommandQueue*
+xfsm_command_queue_new (const gchar        *name,
+                        guint               max_running,
+                        guint               timeout,
+                        XfsmCommandDoneFunc done_func,
+                        gpointer            user_data)
+{
+  XfsmCommandQueue *queue;
+
+  g_return_val_if_fail (name != NULL, NULL);
+  g_return_val_if_fail (max_running > 0, NULL);
+
+  queue = g_slice_new0 (XfsmCommandQueue);
+  queue->name = g_strdup (name);
+  queue->max_running = max_running;
+  queue->timeout = timeout;
+  queue->pending = g_queue_new ();
+  queue->commands = g_hash_table_new (g_str_hash, g_str_equal);
+  queue->done_func = done_func;
+  queue->user_data = user_data;
+
+  return queue;
+}
+
+
+
+/**
+ * xfsm_command_queue_free:
+ * @queue : a #XfsmCommandQueue.
+ *
+ * Commands that did not start yet are spawned without supervision, so
+ * no cleanup is lost when the session manager exits. Commands that are
+ * still running are left alone, but still reaped once they exit.
+ * @done_func is not called for either.
+ **/
+void
+xfsm_command_queue_free (XfsmCommandQueue *queue)
+{
+  XfsmCommand *cmd;
+  GList       *lp;
+
+  g_return_if_fail (queue != NULL);
+
+  while ((cmd = g_queue_pop_head (queue->pending)) != NULL)
+    {
+      xfsm_verbose ("%s queue: running \"%s\" for client %s unsupervised\n",
+                    queue->name, *cmd->command, cmd->client_id);
+
+      g_spawn_async (cmd->working_directory, cmd->command, cmd->environment,
+                     G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, NULL);
+      xfsm_command_free (cmd);
+    }
+
+  for (lp = queue->running; lp != NULL; lp = lp->next)
+    xfsm_command_free (lp->data);
+
+  g_list_free (queue->running);
+  g_queue_free (queue->pending);
+  g_hash_table_destroy (queue->commands);
+  g_free (queue->name);
+
+  g_slice_free (XfsmCommandQueue, queue);
+}
+
+
+
+/**
+ * xfsm_command_queue_push:
+ * @queue             : a #XfsmCommandQueue.
+ * @client_id         : the client the command belongs to, for reporting.
+ * @working_directory : directory to run @command in, or %NULL.
+ * @command           : the argument vector.
+ * @environment       : the environment for @command, or %NULL.
+ *
+ * Queues a copy of @command and starts it as soon as a slot is free.
+ *
+ * Return value: %FALSE if the same command in the same directory is
+ *               already waiting or running, %TRUE otherwise.
+ **/
+gboolean
+xfsm_command_queue_push (XfsmCommandQueue *queue,
+                         const gchar      *client_id,
+                         const gchar      *working_directory,
+                         gchar           **command,
+                         gchar           **environment)
+{
+  XfsmCommand *cmd;
+  gchar       *key;
+
+  g_return_val_if_fail (queue != NULL, FALSE);
+  g_return_val_if_fail (command != NULL && *command != NULL, FALSE);
+
+  key = xfsm_command_make_key (working_directory, command);
+  if (g_hash_table_lookup (queue->commands, key) != NULL)
+    {
+      xfsm_verbose ("%s queue: \"%s\" for client %s is already queued\n",
+                    queue->name, *command, client_id);
+      g_free (key);
+      return FALSE;
+    }
+
+  cmd = g_slice_new0 (XfsmCommand);
+  cmd->queue = queue;
+  cmd->key = key;
+  cmd->client_id = xfsm_intern (client_id);
+  cmd->working_directory = g_strdup (working_directory);
+  cmd->command = g_strdupv (command);
+  cmd->environment = g_strdupv (environment);
+
+  g_hash_table_insert (queue->commands, cmd->key, cmd);
+  g_queue_push_tail (queue->pending, cmd);
+
+  xfsm_command_queue_run_pending (queue);
+
+  return TRUE;
+}
+
+
+
+/**
+ * xfsm_command_queue_abort:
+ * @queue : a #XfsmCommandQueue.
+ *
+ * Kills all running commands right away and drops the waiting ones,
+ * for when the caller's own deadline has passed. @done_func is called
+ * for each of them with @timed_out set, so overruns can be reported.
+ **/
+void
+xfsm_command_queue_abort (XfsmCommandQueue *queue)
+{
+  XfsmCommand *cmd;
+
+  g_return_if_fail (queue != NULL);
+
+  while ((cmd = g_queue_pop_head (queue->pending)) != NULL)
+    {
+      cmd->timed_out = TRUE;
+      xfsm_command_finish (cmd, G_MININT);
+    }
+
+  while (queue->running != NULL)
+    {
+      cmd = queue->running->data;
+
+      xfsm_verbose ("%s queue: killing \"%s\" for client %s\n",
+                    queue->name, *cmd->command, cmd->client_id);
+
+      kill (cmd->pid, SIGKILL);
+      cmd->timed_out = TRUE;
+      xfsm_command_finish (cmd, -SIGKILL);
+    }
+}
+
+
+
+/**
+ * xfsm_command_queue_get_length:
+ * @queue : a #XfsmCommandQueue.
+ *
+ * Return value: the number of commands waiting or running.
+ **/
+guint
+xfsm_command_queue_get_length (XfsmCommandQueue *queue)
+{
+  g_return_val_if_fail (queue != NULL, 0);
+  return g_hash_table_size (queue->commands);
+}
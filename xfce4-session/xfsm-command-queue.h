@@ -0,0 +1,66 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef __XFSM_COMMAND_QUEUE_H__
+#define __XFSM_COMMAND_QUEUE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Runs client supplied commands (discard commands and friends) in the
+ * background, so the main loop and with it all ICE traffic keeps going
+ * while they run. At most max_running commands run at the same time,
+ * identical commands already waiting or running are not queued twice
+ * and each command gets timeout msec before it is sent SIGTERM, and a
+ * little later SIGKILL.
+ */
+
+typedef struct _XfsmCommandQueue XfsmCommandQueue;
+
+/* exit_status is the exit code of the command, the negated signal
+ * number if it was killed, or G_MININT if it failed to start */
+typedef void (*XfsmCommandDoneFunc) (const gchar *client_id,
+                                     gchar      **command,
+                                     gint         exit_status,
+                                     gboolean     timed_out,
+                                     gpointer     user_data);
+
+XfsmCommandQueue *xfsm_command_queue_new        (const gchar        *name,
+                                                 guint               max_running,
+                                                 guint               timeout,
+                                                 XfsmCommandDoneFunc done_func,
+                                                 gpointer            user_data);
+void              xfsm_command_queue_free       (XfsmCommandQueue   *queue);
+
+gboolean          xfsm_command_queue_push       (XfsmCommandQueue   *queue,
+                                                 const gchar        *client_id,
+                                                 const gchar        *working_directory,
+                                                 gchar             **command,
+                                                 gchar             **environment);
+
+void              xfsm_command_queue_abort      (XfsmCommandQueue   *queue);
+
+guint             xfsm_command_queue_get_length (XfsmCommandQueue   *queue);
+
+G_END_DECLS
+
+#endif /* !__XFSM_COMMAND_QUEUE_H__ */
@@ -0,0 +1,590 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include <xfce4-session/xfsm-deadline.h>
+#include <xfce4-session/xfsm-global.h>
+
+
+/* wakeups are rounded up to a multiple of this many usec of the
+ * monotonic clock, so deadlines that expire close to each other are
+ * handled in the same wakeup; none is handled before it expired */
+#define XFSM_DEADLINE_SLACK (10 * 1000)
+
+/* coarse deadlines expire on whole seconds of the monotonic clock, so
+ * they all end up in the same wakeup, like g_timeout_add_seconds() */
+#define XFSM_DEADLINE_SECOND (1000 * 1000)
+
+
+typedef struct _XfsmDeadline XfsmDeadline;
+
+struct _XfsmDeadline
+{
+  guint           id;
+  guint           interval;   /* msec */
+  gint64          expires;    /* monotonic time, usec */
+  gint            index;      /* position in the heap, -1 if not queued */
+  gboolean        destroyed;
+  gboolean        coarse;     /* rounded up to a whole second */
+
+  GSourceFunc     function;
+  gpointer        data;
+  GDestroyNotify  notify;
+};
+
+
+static gboolean xfsm_deadline_source_prepare  (GSource    *source,
+                                               gint       *timeout);
+static gboolean xfsm_deadline_source_check    (GSource    *source);
+static gboolean xfsm_deadline_source_dispatch (GSource    *source,
+                                               GSourceFunc callback,
+                                               gpointer    user_data);
+static guint    xfsm_deadline_add_real        (guint          interval,
+                                               gboolean       coarse,
+                                               GSourceFunc    function,
+                                               gpointer       data,
+                                               GDestroyNotify notify);
+
+
+static GSourceFuncs xfsm_deadline_source_funcs =
+{
+  xfsm_deadline_source_prepare,
+  xfsm_deadline_source_check,
+  xfsm_deadline_source_dispatch,
+  NULL,
+};
+
+static GSource           *heap_source = NULL;
+static GPtrArray         *heap = NULL;
+static GHashTable        *deadlines = NULL;
+static guint              next_id = 1;
+static XfsmDeadlineStats  stats;
+static GPollFunc          real_poll = NULL;
+static guint              n_wakeups = 0;
+
+
+
+static inline gboolean
+xfsm_deadline_before (const XfsmDeadline *a,
+                      const XfsmDeadline *b)
+{
+  /* equal deadlines fire in the order they were added */
+  return a->expires < b->expires
+    || (a->expires == b->expires && a->id < b->id);
+}
+
+
+
+static inline void
+xfsm_deadline_heap_set (guint         index,
+                        XfsmDeadline *deadline)
+{
+  g_ptr_array_index (heap, index) = deadline;
+  deadline->index = index;
+}
+
+
+
+static void
+xfsm_deadline_heap_sift_up (guint index)
+{
+  XfsmDeadline *deadline = g_ptr_array_index (heap, index);
+  XfsmDeadline *parent;
+
+  while (index > 0)
+    {
+      parent = g_ptr_array_index (heap, (index - 1) / 2);
+      if (!xfsm_deadline_before (deadline, parent))
+        break;
+
+      xfsm_deadline_heap_set (index, parent);
+      index = (index - 1) / 2;
+    }
+
+  xfsm_deadline_heap_set (index, deadline);
+}
+
+
+
+static void
+xfsm_deadline_heap_sift_down (guint index)
+{
+  XfsmDeadline *deadline = g_ptr_array_index (heap, index);
+  XfsmDeadline *child;
+  guint         n;
+
+  for (;;)
+    {
+      n = 2 * index + 1;
+      if (n >= heap->len)
+        break;
+
+      /* pick the earlier of the two children */
+      if (n + 1 < heap->len
+          && xfsm_deadline_before (g_ptr_array_index (heap, n + 1),
+                                   g_ptr_array_index (heap, n)))
+        ++n;
+
+      child = g_ptr_array_index (heap, n);
+      if (!xfsm_deadline_before (child, deadline))
+        break;
+
+      xfsm_deadline_heap_set (index, child);
+      index = n;
+    }
+
+  xfsm_deadline_heap_set (index, deadline);
+}
+
+
+
+static void
+xfsm_deadline_heap_push (XfsmDeadline *deadline)
+{
+  g_ptr_array_add (heap, deadline);
+  xfsm_deadline_heap_sift_up (heap->len - 1);
+
+  stats.n_pending = heap->len;
+  if (stats.n_pending > stats.max_pending)
+    stats.max_pending = stats.n_pending;
+}
+
+
+
+static void
+xfsm_deadline_heap_remove (XfsmDeadline *deadline)
+{
+  XfsmDeadline *moved;
+  guint         index;
+
+  g_return_if_fail (deadline->index >= 0);
+
+  /* moves the last element into the hole */
+  index = deadline->index;
+  g_ptr_array_remove_index_fast (heap, index);
+  deadline->index = -1;
+
+  if (index < heap->len)
+    {
+      moved = g_ptr_array_index (heap, index);
+      xfsm_deadline_heap_sift_up (index);
+      xfsm_deadline_heap_sift_down (moved->index);
+    }
+
+  stats.n_pending = heap->len;
+}
+
+
+
+static gint64
+xfsm_deadline_expires (const XfsmDeadline *deadline,
+                       gint64              now)
+{
+  gint64 expires;
+
+  expires = now + (gint64) deadline->interval * 1000;
+
+  if (deadline->coarse)
+    {
+      expires += XFSM_DEADLINE_SECOND - 1;
+      expires -= expires % XFSM_DEADLINE_SECOND;
+    }
+
+  return expires;
+}
+
+
+
+static void
+xfsm_deadline_free (XfsmDeadline *deadline)
+{
+  if (deadline->notify != NULL)
+    deadline->notify (deadline->data);
+
+  g_slice_free (XfsmDeadline, deadline);
+}
+
+
+
+static gboolean
+xfsm_deadline_source_prepare (GSource *source,
+                              gint    *timeout)
+{
+  XfsmDeadline *deadline;
+  gint64        now;
+  gint64        wakeup;
+  gint64        remaining;
+
+  if (heap->len == 0)
+    {
+      *timeout = -1;
+      return FALSE;
+    }
+
+  deadline = g_ptr_array_index (heap, 0);
+  now = g_source_get_time (source);
+
+  if (deadline->expires <= now)
+    {
+      *timeout = 0;
+      return TRUE;
+    }
+
+  /* round up, we never want to wake up early */
+  wakeup = deadline->expires + XFSM_DEADLINE_SLACK - 1;
+  wakeup -= wakeup % XFSM_DEADLINE_SLACK;
+  remaining = (wakeup - now + 999) / 1000;
+  *timeout = (gint) MIN (remaining, G_MAXINT);
+
+  return FALSE;
+}
+
+
+
+static gboolean
+xfsm_deadline_source_check (GSource *source)
+{
+  XfsmDeadline *deadline;
+
+  if (heap->len == 0)
+    return FALSE;
+
+  deadline = g_ptr_array_index (heap, 0);
+
+  return deadline->expires <= g_source_get_time (source);
+}
+
+
+
+static gboolean
+xfsm_deadline_source_dispatch (GSource    *source,
+                               GSourceFunc callback,
+                               gpointer    user_data)
+{
+  XfsmDeadline *deadline;
+  GSList       *rearm = NULL;
+  GSList       *lp;
+  gint64        start;
+  gint64        elapsed;
+  guint         n_expired = 0;
+
+  start = g_get_monotonic_time ();
+
+  while (heap->len > 0)
+    {
+      deadline = g_ptr_array_index (heap, 0);
+      if (deadline->expires > start)
+        break;
+
+      xfsm_deadline_heap_remove (deadline);
+      ++n_expired;
+
+      /* the callback may remove this very deadline, in which case
+       * xfsm_deadline_remove() only marks it as destroyed */
+      if (deadline->function (deadline->data) && !deadline->destroyed)
+        {
+          /* queue it again after this round, so a short interval
+           * cannot keep us spinning in this loop */
+          rearm = g_slist_prepend (rearm, deadline);
+        }
+      else
+        {
+          if (!deadline->destroyed)
+            g_hash_table_remove (deadlines, GUINT_TO_POINTER (deadline->id));
+          xfsm_deadline_free (deadline);
+        }
+    }
+
+  for (lp = rearm; lp != NULL; lp = lp->next)
+    {
+      deadline = lp->data;
+
+      /* removed by a later callback in this round */
+      if (deadline->destroyed)
+        {
+          xfsm_deadline_free (deadline);
+          continue;
+        }
+
+      deadline->expires = xfsm_deadline_expires (deadline, g_get_monotonic_time ());
+      xfsm_deadline_heap_push (deadline);
+    }
+  g_slist_free (rearm);
+
+  elapsed = g_get_monotonic_time () - start;
+
+  stats.n_dispatches++;
+  stats.n_expired += n_expired;
+  stats.dispatch_time += elapsed;
+  if (elapsed > stats.max_dispatch_time)
+    stats.max_dispatch_time = elapsed;
+
+  xfsm_verbose ("Deadline heap: %u expired in %" G_GINT64_FORMAT " usec, "
+                "%u still pending\n", n_expired, elapsed, heap->len);
+
+  /* the source lives as long as the process */
+  return TRUE;
+}
+
+
+
+static void
+xfsm_deadline_init (void)
+{
+  if (G_LIKELY (heap_source != NULL))
+    return;
+
+  heap = g_ptr_array_new ();
+  deadlines = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  heap_source = g_source_new (&xfsm_deadline_source_funcs, sizeof (GSource));
+  g_source_set_priority (heap_source, G_PRIORITY_DEFAULT);
+  g_source_attach (heap_source, NULL);
+}
+
+
+
+/**
+ * xfsm_deadline_add:
+ * @interval : the time after which @function is called, in milliseconds.
+ * @function : the function to call.
+ * @data     : data passed to @function.
+ *
+ * Same as g_timeout_add(), but the deadline is kept in the shared
+ * deadline heap instead of getting its own #GSource.
+ *
+ * Return value: the id of the deadline, never 0.
+ **/
+guint
+xfsm_deadline_add (guint       interval,
+                   GSourceFunc function,
+                   gpointer    data)
+{
+  return xfsm_deadline_add_full (interval, function, data, NULL);
+}
+
+
+
+guint
+xfsm_deadline_add_full (guint          interval,
+                        GSourceFunc    function,
+                        gpointer       data,
+                        GDestroyNotify notify)
+{
+  return xfsm_deadline_add_real (interval, FALSE, function, data, notify);
+}
+
+
+
+/**
+ * xfsm_deadline_add_seconds:
+ * @interval : the time after which @function is called, in seconds.
+ * @function : the function to call.
+ * @data     : data passed to @function.
+ *
+ * Same as g_timeout_add_seconds(): the deadline may expire up to a
+ * second late, so all coarse deadlines share their wakeups. Use this
+ * for everything that is not on the path of a user waiting.
+ *
+ * Return value: the id of the deadline, never 0.
+ **/
+guint
+xfsm_deadline_add_seconds (guint       interval,
+                           GSourceFunc function,
+                           gpointer    data)
+{
+  return xfsm_deadline_add_real (interval * 1000, TRUE, function, data, NULL);
+}
+
+
+
+static guint
+xfsm_deadline_add_real (guint          interval,
+                        gboolean       coarse,
+                        GSourceFunc    function,
+                        gpointer       data,
+                        GDestroyNotify notify)
+{
+  XfsmDeadline *deadline;
+
+  g_return_val_if_fail (function != NULL, 0);
+
+  xfsm_deadline_init ();
+
+  /* skip 0 and ids still in use after a wrap-around */
+  while (next_id == 0
+         || g_hash_table_lookup (deadlines, GUINT_TO_POINTER (next_id)) != NULL)
+    ++next_id;
+
+  deadline = g_slice_new0 (XfsmDeadline);
+  deadline->id = next_id++;
+  deadline->interval = interval;
+  deadline->coarse = coarse;
+  deadline->expires = xfsm_deadline_expires (deadline, g_get_monotonic_time ());
+  deadline->index = -1;
+  deadline->function = function;
+  deadline->data = data;
+  deadline->notify = notify;
+
+  g_hash_table_insert (deadlines, GUINT_TO_POINTER (deadline->id), deadline);
+  xfsm_deadline_heap_push (deadline);
+
+  stats.n_added++;
+  if (coarse)
+    stats.n_coarse++;
+
+  return deadline->id;
+}
+
+
+
+/**
+ * xfsm_deadline_remove:
+ * @deadline_id : an id returned by xfsm_deadline_add().
+ *
+ * Cancels the deadline and calls its destroy notify. It is safe to
+ * call this from within the deadline's own callback.
+ *
+ * Return value: %TRUE if the deadline was found.
+ **/
+gboolean
+xfsm_deadline_remove (guint deadline_id)
+{
+  XfsmDeadline *deadline;
+
+  g_return_val_if_fail (deadline_id > 0, FALSE);
+
+  if (G_UNLIKELY (deadlines == NULL))
+    return FALSE;
+
+  deadline = g_hash_table_lookup (deadlines, GUINT_TO_POINTER (deadline_id));
+  if (G_UNLIKELY (deadline == NULL))
+    {
+      g_warning ("Deadline with id %u was not found", deadline_id);
+      return FALSE;
+    }
+
+  g_hash_table_remove (deadlines, GUINT_TO_POINTER (deadline_id));
+  stats.n_removed++;
+
+  if (deadline->index >= 0)
+    {
+      xfsm_deadline_heap_remove (deadline);
+      xfsm_deadline_free (deadline);
+    }
+  else
+    {
+      /* it is being dispatched right now, the dispatcher frees it */
+      deadline->destroyed = TRUE;
+    }
+
+  return TRUE;
+}
+
+
+
+void
+xfsm_deadline_get_stats (XfsmDeadlineStats *stats_return)
+{
+  g_return_if_fail (stats_return != NULL);
+  *stats_return = stats;
+}
+
+
+
+void
+xfsm_deadline_dump_stats (void)
+{
+  xfsm_verbose ("Deadline heap statistics:\n"
+                "   Added:             %u\n"
+                "   Coarse:            %u\n"
+                "   Removed:           %u\n"
+                "   Expired:           %u\n"
+                "   Wakeups:           %u\n"
+                "   Max pending:       %u\n"
+                "   Dispatch time:     %" G_GINT64_FORMAT " usec\n"
+                "   Longest dispatch:  %" G_GINT64_FORMAT " usec\n\n",
+                stats.n_added, stats.n_coarse, stats.n_removed, stats.n_expired,
+                stats.n_dispatches, stats.max_pending,
+                stats.dispatch_time, stats.max_dispatch_time);
+}
+
+
+
+static gint
+xfsm_deadline_poll (GPollFD *fds,
+                    guint    n_fds,
+                    gint     timeout)
+{
+  /* polls that do not block are no wakeups */
+  if (timeout != 0)
+    ++n_wakeups;
+
+  return real_poll (fds, n_fds, timeout);
+}
+
+
+
+/**
+ * xfsm_deadline_count_wakeups:
+ *
+ * Counts how often the default main loop wakes up from a blocking
+ * poll, for xfsm_deadline_reset_wakeups().
+ **/
+void
+xfsm_deadline_count_wakeups (void)
+{
+  if (real_poll != NULL)
+    return;
+
+  real_poll = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, xfsm_deadline_poll);
+}
+
+
+
+gboolean
+xfsm_deadline_counting_wakeups (void)
+{
+  return real_poll != NULL;
+}
+
+
+
+/**
+ * xfsm_deadline_reset_wakeups:
+ *
+ * Return value: the number of wakeups since the last call.
+ **/
+guint
+xfsm_deadline_reset_wakeups (void)
+{
+  guint n = n_wakeups;
+
+  n_wakeups = 0;
+
+  return n;
+}
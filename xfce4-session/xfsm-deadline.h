@@ -0,0 +1,73 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef __XFSM_DEADLINE_H__
+#define __XFSM_DEADLINE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The session manager keeps all of its protocol deadlines (save, die,
+ * startup and restart-reset timeouts) in a single min-heap that is
+ * driven by one GSource, instead of one g_timeout_add() per client.
+ * The API mirrors g_timeout_add(): the callback returns TRUE to be
+ * re-armed with the same interval and ids are never 0.
+ */
+
+typedef struct _XfsmDeadlineStats XfsmDeadlineStats;
+
+struct _XfsmDeadlineStats
+{
+  guint  n_added;
+  guint  n_coarse;          /* added with xfsm_deadline_add_seconds() */
+  guint  n_removed;
+  guint  n_expired;
+  guint  n_dispatches;
+  guint  n_pending;
+  guint  max_pending;
+  gint64 dispatch_time;     /* usec spent running expired callbacks */
+  gint64 max_dispatch_time; /* usec, longest single dispatch */
+};
+
+guint    xfsm_deadline_add              (guint              interval,
+                                         GSourceFunc        function,
+                                         gpointer           data);
+guint    xfsm_deadline_add_full         (guint              interval,
+                                         GSourceFunc        function,
+                                         gpointer           data,
+                                         GDestroyNotify     notify);
+guint    xfsm_deadline_add_seconds      (guint              interval,
+                                         GSourceFunc        function,
+                                         gpointer           data);
+gboolean xfsm_deadline_remove           (guint              deadline_id);
+
+void     xfsm_deadline_get_stats        (XfsmDeadlineStats *stats);
+void     xfsm_deadline_dump_stats       (void);
+
+/* measurement mode, counts the wakeups of the main loop */
+void     xfsm_deadline_count_wakeups    (void);
+gboolean xfsm_deadline_counting_wakeups (void);
+guint    xfsm_deadline_reset_wakeups    (void);
+
+G_END_DECLS
+
+#endif /* !__XFSM_DEADLINE_H__ */
@@ -0,0 +1,174 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-intern.h>
+
+
+typedef struct _XfsmInternEntry XfsmInternEntry;
+
+struct _XfsmInternEntry
+{
+  guint ref_count;
+  gchar string[1];   /* allocated to fit */
+};
+
+
+/* string -> XfsmInternEntry, the key points into the entry */
+static GHashTable *pool = NULL;
+
+
+
+/**
+ * xfsm_intern:
+ * @string : a string, or %NULL.
+ *
+ * Adds a reference to the pooled copy of @string, creating it if
+ * needed.  Release it with xfsm_unintern().
+ *
+ * Return value: the pooled copy of @string, or %NULL.
+ **/
+const gchar *
+xfsm_intern (const gchar *string)
+{
+  XfsmInternEntry *entry;
+  gsize            length;
+
+  if (G_UNLIKELY (string == NULL))
+    return NULL;
+
+  if (G_UNLIKELY (pool == NULL))
+    pool = g_hash_table_new (g_str_hash, g_str_equal);
+
+  entry = g_hash_table_lookup (pool, string);
+  if (entry == NULL)
+    {
+      length = strlen (string);
+      entry = g_malloc (G_STRUCT_OFFSET (XfsmInternEntry, string) + length + 1);
+      entry->ref_count = 0;
+      memcpy (entry->string, string, length + 1);
+      g_hash_table_insert (pool, entry->string, entry);
+    }
+
+  ++entry->ref_count;
+
+  return entry->string;
+}
+
+
+
+/**
+ * xfsm_intern_lookup:
+ * @string : a string, or %NULL.
+ *
+ * Looks up the pooled copy of @string without adding a reference,
+ * for comparing a foreign string against interned ones.
+ *
+ * Return value: the pooled copy of @string, or %NULL if @string
+ *               is not in the pool.
+ **/
+const gchar *
+xfsm_intern_lookup (const gchar *string)
+{
+  XfsmInternEntry *entry;
+
+  if (G_UNLIKELY (string == NULL || pool == NULL))
+    return NULL;
+
+  entry = g_hash_table_lookup (pool, string);
+
+  return entry != NULL ? entry->string : NULL;
+}
+
+
+
+/**
+ * xfsm_unintern:
+ * @string : a string returned by xfsm_intern(), or %NULL.
+ *
+ * Drops a reference on a pooled string, the string is freed with
+ * the last one.
+ **/
+void
+xfsm_unintern (const gchar *string)
+{
+  XfsmInternEntry *entry;
+
+  if (G_UNLIKELY (string == NULL))
+    return;
+
+  g_return_if_fail (pool != NULL);
+
+  entry = g_hash_table_lookup (pool, string);
+  g_return_if_fail (entry != NULL && entry->string == string);
+
+  if (--entry->ref_count == 0)
+    {
+      g_hash_table_remove (pool, entry->string);
+      g_free (entry);
+    }
+}
+
+
+
+static void
+xfsm_intern_count (gpointer key,
+                   gpointer value,
+                   gpointer user_data)
+{
+  XfsmInternEntry *entry = value;
+  gsize           *counts = user_data;
+  gsize            size = strlen (entry->string) + 1;
+
+  counts[0] += entry->ref_count;
+  counts[1] += size;
+  counts[2] += (entry->ref_count - 1) * size;
+}
+
+
+
+void
+xfsm_intern_dump_stats (void)
+{
+  gsize counts[3] = { 0, 0, 0 };
+
+  if (pool != NULL)
+    g_hash_table_foreach (pool, xfsm_intern_count, counts);
+
+  xfsm_verbose ("String pool statistics:\n"
+                "   Strings:           %u\n"
+                "   References:        %" G_GSIZE_FORMAT "\n"
+                "   Pooled bytes:      %" G_GSIZE_FORMAT "\n"
+                "   Saved bytes:       %" G_GSIZE_FORMAT "\n\n",
+                pool != NULL ? g_hash_table_size (pool) : 0,
+                counts[0], counts[1], counts[2]);
+}
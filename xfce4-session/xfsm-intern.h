@@ -0,0 +1,45 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+
+#ifndef __XFSM_INTERN_H__
+#define __XFSM_INTERN_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Refcounted string pool for client ids, hostnames and program names.
+ * Every distinct string is stored once, so two interned strings are
+ * equal if and only if the pointers are.  Unlike g_intern_string()
+ * the strings are released again, client ids are unique per
+ * registration and would otherwise pile up in a long session.
+ */
+
+const gchar *xfsm_intern            (const gchar *string);
+const gchar *xfsm_intern_lookup     (const gchar *string);
+void         xfsm_unintern          (const gchar *string);
+
+void         xfsm_intern_dump_stats (void);
+
+G_END_DECLS
+
+#endif /* !__XFSM_INTERN_H__ */
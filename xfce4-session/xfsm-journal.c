@@ -0,0 +1,879 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-journal.h>
+
+
+#define XFSM_JOURNAL_HEADER "XFSM-JOURNAL 1"
+
+
+/* Journal records, one per line, fields separated by tabs and escaped
+ * with g_strescape():
+ *
+ *   B <session>         begin of a transaction for "Session: <session>"
+ *   X                   drop all clients and entries of the session
+ *   C <client id>       replace the client, E records follow
+ *   E <key> <value>     entry of the client named by the last C record
+ *   D <client id>       remove the client
+ *   S <key> <value>     set a session wide entry
+ *   U <key>             remove a session wide entry
+ *   K <count>           commit, <count> is the number of records since B
+ */
+
+
+struct _XfsmJournal
+{
+  gchar        *session_file;
+  gchar        *filename;
+
+  /* what the session file and the journal hold for base->session_name */
+  XfsmSnapshot *base;
+
+  /* transactions appended since the last compaction */
+  guint         n_commits;
+
+  /* the writer thread owns everything above while it has work queued,
+   * finished jobs are handed back through |results| */
+  GThreadPool  *pool;
+  GAsyncQueue  *results;
+  gboolean      no_threads;
+};
+
+
+typedef struct
+{
+  XfsmSnapshot    *snapshot;   /* NULL for a compaction */
+  XfsmJournalFunc  func;
+  gpointer         user_data;
+  gboolean         succeed;
+  GError          *error;
+} XfsmJournalJob;
+
+
+static gboolean xfsm_journal_compact_with (XfsmJournal  *journal,
+                                           XfsmSnapshot *snapshot,
+                                           GError      **error);
+
+
+
+static void
+xfsm_journal_append_record (GString     *buffer,
+                            gchar        type,
+                            const gchar *field1,
+                            const gchar *field2)
+{
+  gchar *escaped;
+
+  g_string_append_c (buffer, type);
+
+  if (field1 != NULL)
+    {
+      escaped = g_strescape (field1, NULL);
+      g_string_append_c (buffer, '\t');
+      g_string_append (buffer, escaped);
+      g_free (escaped);
+    }
+
+  if (field2 != NULL)
+    {
+      escaped = g_strescape (field2, NULL);
+      g_string_append_c (buffer, '\t');
+      g_string_append (buffer, escaped);
+      g_free (escaped);
+    }
+
+  g_string_append_c (buffer, '\n');
+}
+
+
+
+/* appends the transaction turning @base into @snapshot, @base is %NULL
+ * if nothing is known about the session yet */
+static void
+xfsm_journal_write_transaction (GString            *buffer,
+                                const XfsmSnapshot *base,
+                                const XfsmSnapshot *snapshot)
+{
+  XfsmSnapshotClient *client;
+  XfsmSnapshotClient *old_client;
+  XfsmSnapshotEntry  *entry;
+  const gchar        *old_value;
+  gchar               count[32];
+  guint               n_records = 0;
+  guint               n;
+  guint               m;
+
+  xfsm_journal_append_record (buffer, 'B', snapshot->session_name, NULL);
+
+  if (base == NULL)
+    {
+      xfsm_journal_append_record (buffer, 'X', NULL, NULL);
+      ++n_records;
+    }
+
+  for (n = 0; n < snapshot->clients->len; ++n)
+    {
+      client = g_ptr_array_index (snapshot->clients, n);
+
+      old_client = base != NULL ? xfsm_snapshot_lookup_client (base, client->client_id) : NULL;
+      if (old_client != NULL && xfsm_snapshot_client_equal (old_client, client))
+        continue;
+
+      xfsm_journal_append_record (buffer, 'C', client->client_id, NULL);
+      ++n_records;
+
+      for (m = 0; m < client->entries->len; ++m)
+        {
+          entry = g_ptr_array_index (client->entries, m);
+          xfsm_journal_append_record (buffer, 'E', entry->key, entry->value);
+          ++n_records;
+        }
+    }
+
+  for (n = 0; base != NULL && n < base->clients->len; ++n)
+    {
+      client = g_ptr_array_index (base->clients, n);
+      if (xfsm_snapshot_lookup_client (snapshot, client->client_id) == NULL)
+        {
+          xfsm_journal_append_record (buffer, 'D', client->client_id, NULL);
+          ++n_records;
+        }
+    }
+
+  for (n = 0; n < snapshot->entries->len; ++n)
+    {
+      entry = g_ptr_array_index (snapshot->entries, n);
+
+      old_value = base != NULL ? xfsm_snapshot_read_entry (base, entry->key) : NULL;
+      if (old_value != NULL && strcmp (old_value, entry->value) == 0)
+        continue;
+
+      xfsm_journal_append_record (buffer, 'S', entry->key, entry->value);
+      ++n_records;
+    }
+
+  for (n = 0; base != NULL && n < base->entries->len; ++n)
+    {
+      entry = g_ptr_array_index (base->entries, n);
+      if (xfsm_snapshot_read_entry (snapshot, entry->key) == NULL)
+        {
+          xfsm_journal_append_record (buffer, 'U', entry->key, NULL);
+          ++n_records;
+        }
+    }
+
+  g_snprintf (count, 32, "%u", n_records);
+  xfsm_journal_append_record (buffer, 'K', count, NULL);
+}
+
+
+
+static gboolean
+xfsm_journal_append (const gchar *filename,
+                     const gchar *data,
+                     gsize        length,
+                     GError     **error)
+{
+  struct stat sb;
+  gssize      n;
+  gsize       written = 0;
+  gint        fd;
+
+  fd = open (filename, O_WRONLY | O_CREAT | O_APPEND, 0600);
+  if (fd < 0 || fstat (fd, &sb) < 0)
+    goto error;
+
+  if (sb.st_size == 0
+      && write (fd, XFSM_JOURNAL_HEADER "\n", sizeof (XFSM_JOURNAL_HEADER "\n") - 1) < 0)
+    goto error;
+
+  while (written < length)
+    {
+      n = write (fd, data + written, length - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      else if (n <= 0)
+        goto error;
+
+      written += n;
+    }
+
+  /* the commit record has to be on disk before we report success */
+  if (fsync (fd) < 0)
+    goto error;
+
+  close (fd);
+
+  return TRUE;
+
+error:
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+               "Failed to write session journal %s: %s",
+               filename, g_strerror (errno));
+
+  if (fd >= 0)
+    {
+      /* don't leave a torn record behind for the next transaction to
+       * be appended to */
+      if (written > 0 && ftruncate (fd, sb.st_size) < 0)
+        g_warning ("Failed to truncate session journal %s", filename);
+      close (fd);
+    }
+
+  return FALSE;
+}
+
+
+
+static gboolean
+xfsm_journal_check_record (gchar      **fields,
+                           gboolean    *have_client)
+{
+  guint n_fields = g_strv_length (fields);
+
+  if (n_fields == 0 || strlen (fields[0]) != 1)
+    return FALSE;
+
+  switch (fields[0][0])
+    {
+    case 'X':
+      *have_client = FALSE;
+      return n_fields == 1;
+
+    case 'C':
+      *have_client = TRUE;
+      return n_fields == 2;
+
+    case 'E':
+      return n_fields == 3 && *have_client;
+
+    case 'D':
+      *have_client = FALSE;
+      return n_fields == 2;
+
+    case 'S':
+      return n_fields == 3;
+
+    case 'U':
+      return n_fields == 2;
+
+    default:
+      return FALSE;
+    }
+}
+
+
+
+static void
+xfsm_journal_apply (XfsmSnapshot *snapshot,
+                    GPtrArray    *records)
+{
+  XfsmSnapshotClient *client = NULL;
+  gchar             **fields;
+  guint               n;
+
+  for (n = 0; n < records->len; ++n)
+    {
+      fields = g_ptr_array_index (records, n);
+
+      switch (fields[0][0])
+        {
+        case 'X':
+          xfsm_snapshot_clear (snapshot);
+          client = NULL;
+          break;
+
+        case 'C':
+          client = xfsm_snapshot_add_client (snapshot, fields[1]);
+          break;
+
+        case 'E':
+          xfsm_snapshot_client_write_entry (client, fields[1], fields[2]);
+          break;
+
+        case 'D':
+          xfsm_snapshot_remove_client (snapshot, fields[1]);
+          client = NULL;
+          break;
+
+        case 'S':
+          xfsm_snapshot_write_entry (snapshot, fields[1], fields[2]);
+          break;
+
+        case 'U':
+          xfsm_snapshot_delete_entry (snapshot, fields[1]);
+          break;
+        }
+    }
+}
+
+
+
+static void
+xfsm_journal_clear_records (GPtrArray *records)
+{
+  g_ptr_array_foreach (records, (GFunc) g_strfreev, NULL);
+  g_ptr_array_set_size (records, 0);
+}
+
+
+
+/* replays the committed transactions of @contents into @snapshots,
+ * loading the sessions from @rc as they are referenced */
+static guint
+xfsm_journal_replay (const gchar *filename,
+                     gchar       *contents,
+                     XfceRc      *rc,
+                     GHashTable  *snapshots)
+{
+  XfsmSnapshot *snapshot;
+  GPtrArray    *records;
+  gchar        *session_name = NULL;
+  gchar       **fields;
+  gchar        *line;
+  gchar        *end;
+  gboolean      have_client = FALSE;
+  guint         n_applied = 0;
+  guint         lineno = 0;
+  guint         n;
+
+  records = g_ptr_array_new ();
+
+  for (line = contents; line != NULL && *line != '\0'; line = end)
+    {
+      end = strchr (line, '\n');
+      if (end == NULL)
+        {
+          /* a torn last line, the transaction is not committed */
+          break;
+        }
+      *end++ = '\0';
+      ++lineno;
+
+      if (lineno == 1)
+        {
+          if (strcmp (line, XFSM_JOURNAL_HEADER) != 0)
+            {
+              g_warning ("%s is not a session journal, ignoring it", filename);
+              break;
+            }
+          continue;
+        }
+
+      fields = g_strsplit (line, "\t", -1);
+      for (n = 0; fields[n] != NULL; ++n)
+        {
+          gchar *compressed = g_strcompress (fields[n]);
+          g_free (fields[n]);
+          fields[n] = compressed;
+        }
+
+      if (fields[0] != NULL && strcmp (fields[0], "B") == 0 && fields[1] != NULL)
+        {
+          if (session_name != NULL)
+            xfsm_verbose ("%s:%u: uncommitted transaction, dropped\n", filename, lineno);
+
+          xfsm_journal_clear_records (records);
+          g_free (session_name);
+          session_name = g_strdup (fields[1]);
+          have_client = FALSE;
+          g_strfreev (fields);
+        }
+      else if (fields[0] != NULL && strcmp (fields[0], "K") == 0 && fields[1] != NULL)
+        {
+          if (session_name != NULL
+              && strtoul (fields[1], NULL, 10) == records->len)
+            {
+              snapshot = g_hash_table_lookup (snapshots, session_name);
+              if (snapshot == NULL)
+                {
+                  snapshot = xfsm_snapshot_load_rc (rc, session_name);
+                  g_hash_table_insert (snapshots, snapshot->session_name, snapshot);
+                }
+
+              xfsm_journal_apply (snapshot, records);
+              ++n_applied;
+            }
+          else
+            {
+              g_warning ("%s:%u: broken commit record, transaction dropped",
+                         filename, lineno);
+            }
+
+          xfsm_journal_clear_records (records);
+          g_free (session_name);
+          session_name = NULL;
+          g_strfreev (fields);
+        }
+      else if (session_name != NULL && xfsm_journal_check_record (fields, &have_client))
+        {
+          g_ptr_array_add (records, fields);
+        }
+      else
+        {
+          g_warning ("%s:%u: invalid record, transaction dropped", filename, lineno);
+
+          xfsm_journal_clear_records (records);
+          g_free (session_name);
+          session_name = NULL;
+          g_strfreev (fields);
+        }
+    }
+
+  if (session_name != NULL)
+    xfsm_verbose ("%s: last transaction was not committed, dropped\n", filename);
+
+  xfsm_journal_clear_records (records);
+  g_ptr_array_free (records, TRUE);
+  g_free (session_name);
+
+  return n_applied;
+}
+
+
+
+/* the rc is written through a temporary file that is renamed over
+ * the old one, make sure the new content is on disk before the
+ * journal goes away */
+static void
+xfsm_journal_sync_file (const gchar *filename)
+{
+  gint fd;
+
+  fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  if (fsync (fd) < 0)
+    g_warning ("Failed to sync %s: %s", filename, g_strerror (errno));
+
+  close (fd);
+}
+
+
+
+static gboolean
+xfsm_journal_compact_with (XfsmJournal  *journal,
+                           XfsmSnapshot *snapshot,
+                           GError      **error)
+{
+  GHashTableIter  iter;
+  GHashTable     *snapshots;
+  XfsmSnapshot   *replayed;
+  XfceRc         *rc;
+  gchar          *contents = NULL;
+  gchar          *backup;
+  guint           n_applied = 0;
+
+  if (!g_file_get_contents (journal->filename, &contents, NULL, NULL))
+    contents = NULL;
+
+  /* nothing to do */
+  if (contents == NULL && snapshot == NULL)
+    return TRUE;
+
+  /* open file for writing, creates it if it doesn't exist */
+  rc = xfce_rc_simple_open (journal->session_file, FALSE);
+  if (G_UNLIKELY (rc == NULL))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "Unable to open session file %s for writing",
+                   journal->session_file);
+      g_free (contents);
+      return FALSE;
+    }
+
+  snapshots = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                     (GDestroyNotify) xfsm_snapshot_free);
+
+  if (contents != NULL)
+    n_applied = xfsm_journal_replay (journal->filename, contents, rc, snapshots);
+
+  /* backup the old session file first */
+  if (g_file_test (journal->session_file, G_FILE_TEST_IS_REGULAR))
+    {
+      backup = g_strconcat (journal->session_file, ".bak", NULL);
+      unlink (backup);
+      if (link (journal->session_file, backup))
+          g_warning ("Failed to create session file backup");
+      g_free (backup);
+    }
+
+  g_hash_table_iter_init (&iter, snapshots);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) &replayed))
+    xfsm_snapshot_store_rc (replayed, rc);
+
+  if (snapshot != NULL)
+    xfsm_snapshot_store_rc (snapshot, rc);
+
+  xfce_rc_close (rc);
+  xfsm_journal_sync_file (journal->session_file);
+
+  if (contents != NULL && unlink (journal->filename) < 0 && errno != ENOENT)
+    g_warning ("Failed to remove session journal %s", journal->filename);
+
+  xfsm_verbose ("Compacted session journal, %u transactions replayed\n", n_applied);
+
+  journal->n_commits = 0;
+
+  g_hash_table_destroy (snapshots);
+  g_free (contents);
+
+  return TRUE;
+}
+
+
+
+/* runs on the worker thread, or on the main thread if there is none */
+static gboolean
+xfsm_journal_write (XfsmJournal  *journal,
+                    XfsmSnapshot *snapshot,
+                    GError      **error)
+{
+  XfsmSnapshot *base = NULL;
+  GString      *buffer;
+  GError       *err = NULL;
+  gboolean      succeed;
+
+  if (journal->base != NULL
+      && strcmp (journal->base->session_name, snapshot->session_name) == 0)
+    base = journal->base;
+
+  buffer = g_string_new (NULL);
+  xfsm_journal_write_transaction (buffer, base, snapshot);
+
+  succeed = xfsm_journal_append (journal->filename, buffer->str, buffer->len, &err);
+  if (succeed)
+    {
+      xfsm_verbose ("Appended %" G_GSIZE_FORMAT " bytes to the session journal\n",
+                    buffer->len);
+      ++journal->n_commits;
+    }
+  else
+    {
+      g_warning ("%s, writing the session file instead", err->message);
+      g_error_free (err);
+    }
+
+  g_string_free (buffer, TRUE);
+
+  if (!succeed)
+    succeed = xfsm_journal_compact_with (journal, snapshot, error);
+  else if (journal->n_commits >= XFSM_JOURNAL_COMPACT_INTERVAL)
+    xfsm_journal_compact_with (journal, NULL, NULL);
+
+  /* without a base the next transaction is a complete one */
+  xfsm_snapshot_free (journal->base);
+  journal->base = succeed ? snapshot : NULL;
+  if (!succeed)
+    xfsm_snapshot_free (snapshot);
+
+  return succeed;
+}
+
+
+
+static void
+xfsm_journal_job_free (XfsmJournalJob *job)
+{
+  xfsm_snapshot_free (job->snapshot);
+  if (job->error != NULL)
+    g_error_free (job->error);
+  g_slice_free (XfsmJournalJob, job);
+}
+
+
+
+static gboolean
+xfsm_journal_results_idle (gpointer user_data)
+{
+  GAsyncQueue    *results = user_data;
+  XfsmJournalJob *job;
+
+  while ((job = g_async_queue_try_pop (results)) != NULL)
+    {
+      job->func (job->succeed, job->error, job->user_data);
+      xfsm_journal_job_free (job);
+    }
+
+  return FALSE;
+}
+
+
+
+static void
+xfsm_journal_run (XfsmJournal    *journal,
+                  XfsmJournalJob *job)
+{
+  XfsmSnapshot *snapshot = job->snapshot;
+
+  if (snapshot != NULL)
+    {
+      /* the journal keeps it as the base of the next transaction */
+      job->snapshot = NULL;
+      job->succeed = xfsm_journal_write (journal, snapshot, &job->error);
+    }
+  else
+    {
+      job->succeed = xfsm_journal_compact_with (journal, NULL, &job->error);
+    }
+}
+
+
+
+static void
+xfsm_journal_finish (XfsmJournal    *journal,
+                     XfsmJournalJob *job)
+{
+  if (job->func == NULL)
+    {
+      if (!job->succeed)
+        g_warning ("%s", job->error->message);
+      xfsm_journal_job_free (job);
+      return;
+    }
+
+  /* report back on the main loop, the idle holds its own reference on
+   * the queue in case the journal is gone by then */
+  g_async_queue_push (journal->results, job);
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, xfsm_journal_results_idle,
+                   g_async_queue_ref (journal->results),
+                   (GDestroyNotify) g_async_queue_unref);
+}
+
+
+
+static void
+xfsm_journal_worker (gpointer data,
+                     gpointer user_data)
+{
+  XfsmJournalJob *job = data;
+  XfsmJournal    *journal = user_data;
+
+  xfsm_journal_run (journal, job);
+  xfsm_journal_finish (journal, job);
+}
+
+
+
+static void
+xfsm_journal_push (XfsmJournal    *journal,
+                   XfsmSnapshot   *snapshot,
+                   XfsmJournalFunc func,
+                   gpointer        user_data)
+{
+  XfsmJournalJob *job;
+  GError         *error = NULL;
+
+  job = g_slice_new0 (XfsmJournalJob);
+  job->snapshot = snapshot;
+  job->func = func;
+  job->user_data = user_data;
+
+  if (journal->pool == NULL && !journal->no_threads)
+    {
+      /* one thread, so jobs run in the order they were queued */
+      journal->pool = g_thread_pool_new (xfsm_journal_worker, journal,
+                                         1, FALSE, &error);
+      if (G_UNLIKELY (journal->pool == NULL))
+        {
+          g_warning ("Failed to create the session writer thread: %s, "
+                     "saving on the main thread", error->message);
+          g_error_free (error);
+          journal->no_threads = TRUE;
+        }
+    }
+
+  if (journal->pool != NULL)
+    {
+      g_thread_pool_push (journal->pool, job, NULL);
+      return;
+    }
+
+  /* no thread, write right away but still report from the main loop */
+  xfsm_journal_run (journal, job);
+  xfsm_journal_finish (journal, job);
+}
+
+
+
+XfsmJournal*
+xfsm_journal_new (const gchar *session_file)
+{
+  XfsmJournal *journal;
+
+  g_return_val_if_fail (session_file != NULL, NULL);
+
+  journal = g_slice_new0 (XfsmJournal);
+  journal->session_file = g_strdup (session_file);
+  journal->filename = g_strconcat (session_file, ".journal", NULL);
+  journal->results = g_async_queue_new ();
+
+  return journal;
+}
+
+
+
+/**
+ * xfsm_journal_free:
+ * @journal : an #XfsmJournal.
+ *
+ * Waits for all queued writes to finish and releases @journal.
+ * Completion callbacks that did not run yet are dropped.
+ **/
+void
+xfsm_journal_free (XfsmJournal *journal)
+{
+  XfsmJournalJob *job;
+
+  if (G_UNLIKELY (journal == NULL))
+    return;
+
+  xfsm_journal_wait (journal);
+
+  while ((job = g_async_queue_try_pop (journal->results)) != NULL)
+    xfsm_journal_job_free (job);
+  g_async_queue_unref (journal->results);
+
+  xfsm_snapshot_free (journal->base);
+  g_free (journal->session_file);
+  g_free (journal->filename);
+
+  g_slice_free (XfsmJournal, journal);
+}
+
+
+
+/**
+ * xfsm_journal_commit:
+ * @journal   : an #XfsmJournal.
+ * @snapshot  : the session to save, the journal takes ownership and
+ *              it must not be modified anymore.
+ * @func      : function called on the main loop once @snapshot is on
+ *              disk or writing it failed, or %NULL.
+ * @user_data : data passed to @func.
+ *
+ * Queues @snapshot for the writer thread, which appends the difference
+ * between the last committed state of the session and @snapshot to the
+ * journal.  If the journal cannot be written, all pending transactions
+ * and @snapshot are written to the session file directly.
+ **/
+void
+xfsm_journal_commit (XfsmJournal    *journal,
+                     XfsmSnapshot   *snapshot,
+                     XfsmJournalFunc func,
+                     gpointer        user_data)
+{
+  g_return_if_fail (journal != NULL);
+  g_return_if_fail (snapshot != NULL);
+
+  xfsm_journal_push (journal, snapshot, func, user_data);
+}
+
+
+
+/**
+ * xfsm_journal_compact_async:
+ * @journal : an #XfsmJournal.
+ *
+ * Queues a compaction behind the pending commits.  Errors are only
+ * logged.
+ **/
+void
+xfsm_journal_compact_async (XfsmJournal *journal)
+{
+  g_return_if_fail (journal != NULL);
+  xfsm_journal_push (journal, NULL, NULL, NULL);
+}
+
+
+
+/**
+ * xfsm_journal_wait:
+ * @journal : an #XfsmJournal.
+ *
+ * Blocks until the writer thread has finished all queued jobs.
+ **/
+void
+xfsm_journal_wait (XfsmJournal *journal)
+{
+  g_return_if_fail (journal != NULL);
+
+  if (journal->pool == NULL)
+    return;
+
+  /* the pool is created again on the next commit */
+  g_thread_pool_free (journal->pool, FALSE, TRUE);
+  journal->pool = NULL;
+}
+
+
+
+/**
+ * xfsm_journal_compact:
+ * @journal : an #XfsmJournal.
+ * @error   : return location for errors or %NULL.
+ *
+ * Replays the committed transactions of the journal into the session
+ * file and removes the journal.  Waits for queued writes first.
+ *
+ * Return value: %FALSE if the session file could not be written.
+ **/
+gboolean
+xfsm_journal_compact (XfsmJournal *journal,
+                      GError     **error)
+{
+  g_return_val_if_fail (journal != NULL, FALSE);
+
+  xfsm_journal_wait (journal);
+
+  return xfsm_journal_compact_with (journal, NULL, error);
+}
@@ -0,0 +1,70 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef __XFSM_JOURNAL_H__
+#define __XFSM_JOURNAL_H__
+
+#include <glib.h>
+
+#include <xfce4-session/xfsm-snapshot.h>
+
+G_BEGIN_DECLS
+
+/* Instead of rewriting the whole session file on every checkpoint, the
+ * changes since the previous save are appended to "<session file>.journal"
+ * as one transaction per save: the clients that changed (keyed by client
+ * id), the clients that went away and the session wide entries that
+ * changed, followed by a commit record.  The journal is fsync()ed after
+ * every commit.  Transactions without a commit record, e.g. after a
+ * crash in the middle of a write, are ignored.  Compaction replays the
+ * journal into the session file and removes it again; it happens at
+ * startup, at logout and every XFSM_JOURNAL_COMPACT_INTERVAL commits.
+ *
+ * Commits and compactions at runtime are done by a writer thread, so
+ * a slow disk or NFS home directory does not stall the ICE connections.
+ * The snapshot is built on the main thread and is not touched there
+ * anymore once it was handed to xfsm_journal_commit().
+ */
+
+#define XFSM_JOURNAL_COMPACT_INTERVAL 32
+
+typedef struct _XfsmJournal XfsmJournal;
+
+typedef void (*XfsmJournalFunc) (gboolean      succeed,
+                                 const GError *error,
+                                 gpointer      user_data);
+
+XfsmJournal *xfsm_journal_new           (const gchar    *session_file);
+void         xfsm_journal_free          (XfsmJournal    *journal);
+
+void         xfsm_journal_commit        (XfsmJournal    *journal,
+                                         XfsmSnapshot   *snapshot,
+                                         XfsmJournalFunc func,
+                                         gpointer        user_data);
+void         xfsm_journal_compact_async (XfsmJournal    *journal);
+void         xfsm_journal_wait          (XfsmJournal    *journal);
+
+gboolean     xfsm_journal_compact       (XfsmJournal    *journal,
+                                         GError        **error);
+
+G_END_DECLS
+
+#endif /* !__XFSM_JOURNAL_H__ */
@@ -115,6 +115,12 @@ typedef struct
 static GList *restart_apps = NULL;
 static GList *window_list = NULL;
 
+/* |window_list| is only filled by a save of the legacy applications,
+ * stores without one (autosave) write the Legacy entries of the last
+ * save, or of the session file, again */
+static gboolean      window_list_saved = FALSE;
+static XfsmSnapshot *stored_entries = NULL;
+
 
 /* X Atoms */
 static Atom _XA_WM_PROTOCOLS     = None;
@@ -488,19 +494,26 @@ xfsm_legacy_perform_session_save (void)
             sm_window->type = SM_ERROR;
         }
     }
+
+  window_list_saved = TRUE;
 #endif
 }
 
 
-void
-xfsm_legacy_store_session (XfceRc *rc)
-{
 #ifdef LEGACY_SESSION_MANAGEMENT
+static void
+xfsm_legacy_store_window_list (void)
+{
   int count = 0;
   SmWindow *sm_window;
   GList *lp;
   gchar buffer[256];
 
+  if (stored_entries == NULL)
+    stored_entries = xfsm_snapshot_new ("Legacy");
+  else
+    xfsm_snapshot_clear (stored_entries);
+
   for (lp = window_list; lp != NULL; lp = lp->next)
     {
       sm_window = SM_WINDOW (lp->data);
@@ -528,19 +541,47 @@ xfsm_legacy_store_session (XfceRc *rc)
             }
 
           g_snprintf (buffer, 256, "Legacy%d_Screen", count);
-          xfce_rc_write_int_entry (rc, buffer, sm_window->screen_num);
+          xfsm_snapshot_write_int_entry (stored_entries, buffer, sm_window->screen_num);
 
           g_snprintf (buffer, 256, "Legacy%d_Command", count);
-          xfce_rc_write_list_entry (rc, buffer, sm_window->wm_command, NULL);
+          xfsm_snapshot_write_list_entry (stored_entries, buffer, sm_window->wm_command);
 
           g_snprintf (buffer, 256, "Legacy%d_ClientMachine", count);
-          xfce_rc_write_entry (rc, buffer, sm_window->wm_client_machine);
+          xfsm_snapshot_write_entry (stored_entries, buffer, sm_window->wm_client_machine);
 
           ++count;
         }
     }
 
-  xfce_rc_write_int_entry (rc, "LegacyCount", count);
+  xfsm_snapshot_write_int_entry (stored_entries, "LegacyCount", count);
+}
+#endif
+
+
+void
+xfsm_legacy_store_session (XfsmSnapshot *snapshot)
+{
+#ifdef LEGACY_SESSION_MANAGEMENT
+  XfsmSnapshotEntry *entry;
+  guint n;
+
+  if (window_list_saved)
+    {
+      xfsm_legacy_store_window_list ();
+      window_list_saved = FALSE;
+    }
+
+  if (stored_entries == NULL)
+    {
+      xfsm_snapshot_write_int_entry (snapshot, "LegacyCount", 0);
+      return;
+    }
+
+  for (n = 0; n < stored_entries->entries->len; ++n)
+    {
+      entry = g_ptr_array_index (stored_entries->entries, n);
+      xfsm_snapshot_write_entry (snapshot, entry->key, entry->value);
+    }
 #endif
 }
 
@@ -555,6 +596,14 @@ xfsm_legacy_load_session (XfceRc *rc)
   gchar **command;
   SmRestartApp *app;
   int screen_num;
+  const gchar *machine;
+  int n_stored = 0;
+
+  /* kept for stores until the next save of the legacy applications */
+  if (stored_entries == NULL)
+    stored_entries = xfsm_snapshot_new ("Legacy");
+  else
+    xfsm_snapshot_clear (stored_entries);
 
   count = xfce_rc_read_int_entry (rc, "LegacyCount", 0);
   for (i = 0; i < count; ++i)
@@ -562,6 +611,9 @@ xfsm_legacy_load_session (XfceRc *rc)
       g_snprintf (buffer, 256, "Legacy%d_Screen", i);
       screen_num = xfce_rc_read_int_entry (rc, buffer, 0);
 
+      g_snprintf (buffer, 256, "Legacy%d_ClientMachine", i);
+      machine = xfce_rc_read_entry (rc, buffer, NULL);
+
       g_snprintf (buffer, 256, "Legacy%d_Command", i);
       command = xfce_rc_read_list_entry (rc, buffer, NULL);
       if (command == NULL)
@@ -576,12 +628,28 @@ xfsm_legacy_load_session (XfceRc *rc)
           g_free (dbg_command);
         }
 
+      if (machine != NULL)
+        {
+          g_snprintf (buffer, 256, "Legacy%d_Screen", n_stored);
+          xfsm_snapshot_write_int_entry (stored_entries, buffer, screen_num);
+
+          g_snprintf (buffer, 256, "Legacy%d_Command", n_stored);
+          xfsm_snapshot_write_list_entry (stored_entries, buffer, command);
+
+          g_snprintf (buffer, 256, "Legacy%d_ClientMachine", n_stored);
+          xfsm_snapshot_write_entry (stored_entries, buffer, machine);
+
+          ++n_stored;
+        }
+
       app = g_new0 (SmRestartApp, 1);
       app->screen_num = screen_num;
       app->command = command;
 
       restart_apps = g_list_append (restart_apps, app);
     }
+
+  xfsm_snapshot_write_int_entry (stored_entries, "LegacyCount", n_stored);
 #endif
 }
 
@@ -26,9 +26,11 @@
 
 #include <libxfce4util/libxfce4util.h>
 
+#include <xfce4-session/xfsm-snapshot.h>
+
 
 void xfsm_legacy_perform_session_save (void);
-void xfsm_legacy_store_session (XfceRc *rc);
+void xfsm_legacy_store_session (XfsmSnapshot *snapshot);
 void xfsm_legacy_load_session (XfceRc *rc);
 void xfsm_legacy_init (void);
 void xfsm_legacy_startup (void);
@@ -25,9 +25,19 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
 #ifdef HAVE_MEMORY_H
 #include <memory.h>
 #endif
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -65,12 +75,13 @@
 
 #include <X11/ICE/ICElib.h>
 #include <X11/SM/SMlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
 
 #include <gdk-pixbuf/gdk-pixdata.h>
+#include <gdk/gdkx.h>
 #include <gtk/gtk.h>
 
-#include <libwnck/libwnck.h>
-
 #include <libxfce4ui/libxfce4ui.h>
 
 #include <libxfsm/xfsm-splash-engine.h>
@@ -79,8 +90,13 @@
 #include <xfce4-session/xfsm-manager.h>
 #include <xfce4-session/xfsm-chooser-icon.h>
 #include <xfce4-session/xfsm-chooser.h>
+#include <xfce4-session/xfsm-command-queue.h>
+#include <xfce4-session/xfsm-deadline.h>
 #include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-intern.h>
+#include <xfce4-session/xfsm-journal.h>
 #include <xfce4-session/xfsm-legacy.h>
+#include <xfce4-session/xfsm-save-stats.h>
 #include <xfce4-session/xfsm-startup.h>
 #include <xfce4-session/xfsm-marshal.h>
 #include <xfce4-session/xfsm-error.h>
@@ -88,6 +104,11 @@
 
 
 #define DEFAULT_SESSION_NAME "Default"
+#define LIVE_SESSION_NAME    "Live"
+
+#define SCREENSAVER_NAME      "org.freedesktop.ScreenSaver"
+#define SCREENSAVER_PATH      "/org/freedesktop/ScreenSaver"
+#define SCREENSAVER_INTERFACE SCREENSAVER_NAME
 
 
 struct _XfsmManager
@@ -103,10 +124,42 @@ struct _XfsmManager
   gboolean         session_chooser;
   gchar           *session_name;
   gchar           *session_file;
+  XfsmJournal     *journal;
   gchar           *checkpoint_session_name;
 
+  /* autosave, interval in seconds, 0 if disabled */
+  guint            autosave_interval;
+  guint            autosave_id;
+  gboolean         session_dirty;
+
+  /* the running clients, kept on disk while we run so a manager that
+   * is started again after a crash finds them */
+  gchar           *live_file;
+  XfsmJournal     *live_journal;
+  guint            live_update_id;
+
   gboolean         start_at;
 
+  /* skip SaveYourself at logout for clients without state */
+  gboolean         fast_logout;
+
+  /* emit SmPropertyChanged for every property in addition to the
+   * batched SmPropertiesChanged signal */
+  gboolean         property_signals;
+
+  /* stop the clients while the screensaver is active; clients whose
+   * program is in |freeze_exempt| or that start before
+   * |freeze_min_priority| (the window manager, panel, desktop...) keep
+   * running */
+  gboolean         freeze_on_lock;
+  gchar          **freeze_exempt;
+  gint             freeze_min_priority;
+  DBusGProxy      *screensaver_proxy;
+  gboolean         screensaver_active;
+  DBusGProxy      *bus_proxy;        /* for the owner of the screensaver name */
+  GPid             screensaver_pid;
+  GHashTable      *frozen_clients;   /* XfsmClient -> pid */
+
   gboolean         compat_gnome;
   gboolean         compat_kde;
 
@@ -115,10 +168,42 @@ struct _XfsmManager
   GQueue          *restart_properties;
   GQueue          *running_clients;
 
+  /* clients that outlived a crashed manager, until they register again */
+  GQueue          *recovered_properties;
+
   gboolean         failsafe_mode;
   GQueue          *failsafe_clients;
 
   guint            die_timeout_id;
+  guint            die_escalate_id;
+  guint            die_group_id;
+  gint             die_priority;
+  gint64           die_deadline;     /* end of the DIE_TIMEOUT, monotonic */
+  guint            die_escalate_timeout;
+
+  XfsmCommandQueue *discard_queue;
+  XfsmCommandQueue *shutdown_queue;
+  guint             shutdown_overruns;
+
+  /* clients waiting for their SaveYourself of a checkpoint or logout,
+   * at most save_max_outstanding are saving at a time, 0 is no limit */
+  GQueue           *save_queue;
+  guint             save_max_outstanding;
+  gint              save_type;
+  gboolean          save_shutdown;
+  gint              save_interact_style;
+  gboolean          save_fast;
+  gint64            save_started;
+  guint             save_peak;
+
+  /* XfsmClient -> monotonic time its SaveYourself was sent */
+  GHashTable       *save_times;
+  XfsmSaveStats    *save_stats;
+  gchar            *save_stats_file;
+
+  /* measurement mode, wakeups of the main loop per idle minute */
+  guint             wakeups_id;
+  gboolean          wakeups_idle;
 
   DBusGConnection *session_bus;
 };
@@ -136,6 +221,12 @@ typedef struct _XfsmManagerClass
                              const gchar *client_object_path);
 
   void (*shutdown_cancelled) (XfsmManager *manager);
+
+  void (*discard_command_finished) (XfsmManager *manager,
+                                    const gchar *client_id,
+                                    const gchar *command,
+                                    gint         exit_status,
+                                    gboolean     timed_out);
 } XfsmManagerClass;
 
 typedef struct
@@ -157,6 +248,7 @@ enum
   SIG_STATE_CHANGED = 0,
   SIG_CLIENT_REGISTERED,
   SIG_SHUTDOWN_CANCELLED,
+  SIG_DISCARD_COMMAND_FINISHED,
   N_SIGS,
 };
 
@@ -169,6 +261,31 @@ static void       xfsm_manager_start_client_save_timeout (XfsmManager *manager,
 static void       xfsm_manager_cancel_client_save_timeout (XfsmManager *manager,
                                                            XfsmClient  *client);
 static gboolean   xfsm_manager_save_timeout (gpointer user_data);
+static void       xfsm_manager_discard_done (const gchar *client_id,
+                                             gchar      **command,
+                                             gint         exit_status,
+                                             gboolean     timed_out,
+                                             gpointer     user_data);
+static void       xfsm_manager_shutdown_command_done (const gchar *client_id,
+                                                      gchar      **command,
+                                                      gint         exit_status,
+                                                      gboolean     timed_out,
+                                                      gpointer     user_data);
+static void       xfsm_manager_maybe_finish_die_phase (XfsmManager *manager);
+static void       xfsm_manager_die_next_group (XfsmManager *manager);
+static gboolean   xfsm_manager_die_group_done (XfsmManager *manager);
+static void       xfsm_manager_save_started (XfsmManager *manager,
+                                             XfsmClient  *client);
+static void       xfsm_manager_save_finished (XfsmManager *manager,
+                                              XfsmClient  *client);
+static void       xfsm_manager_save_next (XfsmManager *manager);
+static GPid       xfsm_manager_get_properties_pid (XfsmProperties *properties);
+static void       xfsm_manager_remove_live_state (XfsmManager *manager);
+static void       xfsm_manager_recover_live_state (XfsmManager *manager);
+static void       xfsm_manager_freeze_clients (XfsmManager *manager);
+static void       xfsm_manager_thaw_clients (XfsmManager *manager);
+static void       xfsm_manager_watch_screensaver (XfsmManager *manager);
+static gboolean   xfsm_manager_report_wakeups (gpointer user_data);
 static void       xfsm_manager_load_settings (XfsmManager   *manager,
                                               XfconfChannel *channel);
 static gboolean   xfsm_manager_load_session (XfsmManager *manager);
@@ -219,6 +336,17 @@ xfsm_manager_class_init (XfsmManagerClass *klass)
                                                   g_cclosure_marshal_VOID__VOID,
                                                   G_TYPE_NONE, 0);
 
+  signals[SIG_DISCARD_COMMAND_FINISHED] = g_signal_new ("discard-command-finished",
+                                                        XFSM_TYPE_MANAGER,
+                                                        G_SIGNAL_RUN_LAST,
+                                                        G_STRUCT_OFFSET (XfsmManagerClass,
+                                                                         discard_command_finished),
+                                                        NULL, NULL,
+                                                        xfsm_marshal_VOID__STRING_STRING_INT_BOOLEAN,
+                                                        G_TYPE_NONE, 4,
+                                                        G_TYPE_STRING, G_TYPE_STRING,
+                                                        G_TYPE_INT, G_TYPE_BOOLEAN);
+
   xfsm_manager_dbus_class_init (klass);
 }
 
@@ -232,12 +360,33 @@ xfsm_manager_init (XfsmManager *manager)
   manager->shutdown_type = XFSM_SHUTDOWN_LOGOUT;
   manager->shutdown_helper = xfsm_shutdown_get ();
   manager->save_session = TRUE;
+  manager->property_signals = FALSE;
 
   manager->pending_properties = g_queue_new ();
   manager->starting_properties = g_queue_new ();
   manager->restart_properties = g_queue_new ();
+  manager->recovered_properties = g_queue_new ();
   manager->running_clients = g_queue_new ();
   manager->failsafe_clients = g_queue_new ();
+
+  manager->save_queue = g_queue_new ();
+  manager->save_times = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  manager->frozen_clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+  manager->save_stats = xfsm_save_stats_new ();
+
+  manager->discard_queue = xfsm_command_queue_new ("discard",
+                                                   DISCARD_MAX_RUNNING,
+                                                   DISCARD_TIMEOUT,
+                                                   xfsm_manager_discard_done,
+                                                   manager);
+
+  /* all shutdown commands run at once, so logout takes as long as the
+   * slowest one instead of all of them together */
+  manager->shutdown_queue = xfsm_command_queue_new ("shutdown",
+                                                    G_MAXUINT,
+                                                    SHUTDOWN_COMMAND_TIMEOUT,
+                                                    xfsm_manager_shutdown_command_done,
+                                                    manager);
 }
 
 static void
@@ -245,10 +394,32 @@ xfsm_manager_finalize (GObject *obj)
 {
   XfsmManager *manager = XFSM_MANAGER(obj);
 
+  /* never leave stopped processes behind */
+  xfsm_manager_thaw_clients (manager);
+  g_hash_table_destroy (manager->frozen_clients);
+  g_strfreev (manager->freeze_exempt);
+  if (manager->screensaver_proxy != NULL)
+    g_object_unref (G_OBJECT (manager->screensaver_proxy));
+  if (manager->bus_proxy != NULL)
+    g_object_unref (G_OBJECT (manager->bus_proxy));
+
   xfsm_manager_dbus_cleanup (manager);
 
   if (manager->die_timeout_id != 0)
-    g_source_remove (manager->die_timeout_id);
+    xfsm_deadline_remove (manager->die_timeout_id);
+  if (manager->die_escalate_id != 0)
+    xfsm_deadline_remove (manager->die_escalate_id);
+  if (manager->die_group_id != 0)
+    xfsm_deadline_remove (manager->die_group_id);
+  if (manager->autosave_id != 0)
+    xfsm_deadline_remove (manager->autosave_id);
+  if (manager->live_update_id != 0)
+    xfsm_deadline_remove (manager->live_update_id);
+  if (manager->wakeups_id != 0)
+    xfsm_deadline_remove (manager->wakeups_id);
+
+  xfsm_command_queue_free (manager->discard_queue);
+  xfsm_command_queue_free (manager->shutdown_queue);
 
   g_object_unref (manager->shutdown_helper);
 
@@ -261,14 +432,33 @@ xfsm_manager_finalize (GObject *obj)
   g_queue_foreach (manager->restart_properties, (GFunc) xfsm_properties_free, NULL);
   g_queue_free (manager->restart_properties);
 
+  g_queue_foreach (manager->recovered_properties, (GFunc) xfsm_properties_free, NULL);
+  g_queue_free (manager->recovered_properties);
+
   g_queue_foreach (manager->running_clients, (GFunc) g_object_unref, NULL);
   g_queue_free (manager->running_clients);
 
   g_queue_foreach (manager->failsafe_clients, (GFunc) xfsm_failsafe_client_free, NULL);
   g_queue_free (manager->failsafe_clients);
 
+  g_queue_free (manager->save_queue);
+  g_hash_table_destroy (manager->save_times);
+  if (manager->save_stats_file != NULL)
+    xfsm_save_stats_store (manager->save_stats, manager->save_stats_file);
+  xfsm_save_stats_free (manager->save_stats);
+  g_free (manager->save_stats_file);
+
   g_free (manager->session_name);
   g_free (manager->session_file);
+  xfsm_journal_free (manager->journal);
+
+  /* a clean exit, there is nothing to recover */
+  if (manager->live_journal != NULL)
+    {
+      xfsm_journal_free (manager->live_journal);
+      xfsm_manager_remove_live_state (manager);
+    }
+  g_free (manager->live_file);
   g_free (manager->checkpoint_session_name);
 
   G_OBJECT_CLASS (xfsm_manager_parent_class)->finalize (obj);
@@ -302,6 +492,15 @@ xfsm_manager_set_state (XfsmManager     *manager,
                 state == XFSM_MANAGER_SHUTDOWNPHASE2 ? "XFSM_MANAGER_SHUTDOWNPHASE2" :
                 "unknown");
 
+  /* the running minute is no idle minute anymore */
+  manager->wakeups_idle = FALSE;
+
+  /* clients have to answer while we save or shut down */
+  if (old_state == XFSM_MANAGER_IDLE)
+    xfsm_manager_thaw_clients (manager);
+  else if (state == XFSM_MANAGER_IDLE)
+    xfsm_manager_freeze_clients (manager);
+
   g_signal_emit (manager, signals[SIG_STATE_CHANGED], 0, old_state, state);
 }
 
@@ -327,17 +526,82 @@ xfsm_manager_startup (XfsmManager *manager)
 }
 
 
+/* EWMH atoms of the default display, see xfsm_manager_intern_atoms() */
+static Atom _NET_CURRENT_DESKTOP = None;
+static Atom _NET_NUMBER_OF_DESKTOPS = None;
+
+
+static void
+xfsm_manager_intern_atoms (Display *dpy)
+{
+  static gchar *names[] = { "_NET_CURRENT_DESKTOP", "_NET_NUMBER_OF_DESKTOPS" };
+  Atom          atoms[G_N_ELEMENTS (names)];
+
+  if (G_LIKELY (_NET_CURRENT_DESKTOP != None))
+    return;
+
+  /* one round-trip for both */
+  XInternAtoms (dpy, names, G_N_ELEMENTS (names), False, atoms);
+  _NET_CURRENT_DESKTOP = atoms[0];
+  _NET_NUMBER_OF_DESKTOPS = atoms[1];
+}
+
+
+/* reads a CARDINAL property of the root window of |screen|, this is a
+ * single round-trip, unlike a libwnck force update which fetches all
+ * windows and their properties */
+static gboolean
+xfsm_manager_get_root_cardinal (GdkScreen *screen,
+                                Atom       property,
+                                glong     *value_return)
+{
+  Display       *dpy = GDK_DISPLAY_XDISPLAY (gdk_screen_get_display (screen));
+  Atom           actual_type;
+  gint           actual_format;
+  gulong         nitems;
+  gulong         leftover;
+  guchar        *data = NULL;
+  gint           status;
+  gboolean       succeed = FALSE;
+
+  gdk_error_trap_push ();
+  status = XGetWindowProperty (dpy, GDK_WINDOW_XID (gdk_screen_get_root_window (screen)),
+                               property, 0L, 1L, False, XA_CARDINAL,
+                               &actual_type, &actual_format,
+                               &nitems, &leftover, &data);
+  if (gdk_error_trap_pop () == 0 && status == Success && data != NULL)
+    {
+      if (actual_type == XA_CARDINAL && actual_format == 32 && nitems == 1)
+        {
+          *value_return = *((glong *) data);
+          succeed = TRUE;
+        }
+    }
+
+  if (data != NULL)
+    XFree (data);
+
+  return succeed;
+}
+
+
 static void
 xfsm_manager_restore_active_workspace (XfsmManager *manager,
                                        XfceRc      *rc)
 {
-  WnckWorkspace  *workspace;
   GdkDisplay     *display;
-  WnckScreen     *screen;
+  GdkScreen      *screen;
+  Display        *dpy;
+  Window          root;
+  XEvent          xev;
   gchar           buffer[1024];
+  glong           count;
   gint            n, m;
 
   display = gdk_display_get_default ();
+  dpy = GDK_DISPLAY_XDISPLAY (display);
+  xfsm_manager_intern_atoms (dpy);
+
   for (n = 0; n < gdk_display_get_n_screens (display); ++n)
     {
       g_snprintf (buffer, 1024, "Screen%d_ActiveWorkspace", n);
@@ -350,15 +614,30 @@ xfsm_manager_restore_active_workspace (XfsmManager *manager,
 
       m = xfce_rc_read_int_entry (rc, buffer, 0);
 
-      screen = wnck_screen_get (n);
-      wnck_screen_force_update (screen);
+      screen = gdk_display_get_screen (display, n);
+      if (!xfsm_manager_get_root_cardinal (screen, _NET_NUMBER_OF_DESKTOPS, &count)
+          || m < 0 || m >= count)
+        continue;
 
-      if (wnck_screen_get_workspace_count (screen) > m)
-        {
-          workspace = wnck_screen_get_workspace (screen, m);
-          wnck_workspace_activate (workspace, GDK_CURRENT_TIME);
-        }
+      /* ask the window manager to switch, see the EWMH spec, no reply
+       * is needed */
+      root = GDK_WINDOW_XID (gdk_screen_get_root_window (screen));
+
+      memset (&xev, 0, sizeof (xev));
+      xev.xclient.type = ClientMessage;
+      xev.xclient.send_event = True;
+      xev.xclient.display = dpy;
+      xev.xclient.window = root;
+      xev.xclient.message_type = _NET_CURRENT_DESKTOP;
+      xev.xclient.format = 32;
+      xev.xclient.data.l[0] = m;
+      xev.xclient.data.l[1] = CurrentTime;
+
+      XSendEvent (dpy, root, False,
+                  SubstructureRedirectMask | SubstructureNotifyMask, &xev);
     }
+
+  XFlush (dpy);
 }
 
 
@@ -367,7 +646,6 @@ xfsm_manager_handle_failed_properties (XfsmManager    *manager,
                                        XfsmProperties *properties)
 {
   gint restart_style_hint;
-  GError *error = NULL;
 
   /* Handle apps that failed to start, or died randomly, here */
 
@@ -375,7 +653,7 @@ xfsm_manager_handle_failed_properties (XfsmManager    *manager,
 
   if (properties->restart_attempts_reset_id > 0)
     {
-      g_source_remove (properties->restart_attempts_reset_id);
+      xfsm_deadline_remove (properties->restart_attempts_reset_id);
       properties->restart_attempts_reset_id = 0;
     }
 
@@ -447,22 +725,7 @@ xfsm_manager_handle_failed_properties (XfsmManager    *manager,
            * ever-growing number of xfwm4 session files when restarting
            * xfwm4 within a session.
            */
-          xfsm_verbose ("Client Id = %s: running discard command %s:%d.\n\n",
-                        properties->client_id, *discard_command,
-                        g_strv_length (discard_command));
-
-          if (!g_spawn_sync (xfsm_properties_get_string (properties, SmCurrentDirectory),
-                             discard_command,
-                             xfsm_properties_get_strv (properties, SmEnvironment),
-                             G_SPAWN_SEARCH_PATH,
-                             NULL, NULL,
-                             NULL, NULL,
-                             NULL, &error))
-            {
-              g_warning ("Failed to running discard command \"%s\": %s",
-                         *discard_command, error->message);
-              g_error_free (error);
-            }
+          xfsm_manager_run_discard_command (manager, properties, discard_command);
         }
 
       return FALSE;
@@ -553,9 +816,11 @@ xfsm_manager_choose_session (XfsmManager *manager,
 static gboolean
 xfsm_manager_load_session (XfsmManager *manager)
 {
-  XfsmProperties *properties;
   gchar           buffer[1024];
   XfceRc         *rc;
+  GList          *loaded;
+  GList          *found;
+  GList          *lp;
   gint            count;
 
   if (!g_file_test (manager->session_file, G_FILE_TEST_IS_REGULAR))
@@ -589,32 +854,41 @@ xfsm_manager_load_session (XfsmManager *manager)
       return FALSE;
     }
 
-  while (count-- > 0)
+  /* one pass over the file instead of a lookup per known key and client */
+  loaded = xfsm_properties_load_session (manager->session_file,
+                                         manager->session_name);
+  for (lp = loaded; lp != NULL; lp = lp->next)
+    g_queue_push_tail (manager->pending_properties, lp->data);
+  g_list_free (loaded);
+
+  xfsm_verbose ("Finished loading clients from rc file\n");
+
+  /* don't start a second instance of clients that are still running */
+  for (lp = g_queue_peek_nth_link (manager->recovered_properties, 0);
+       lp;
+       lp = lp->next)
     {
-      g_snprintf (buffer, 1024, "Client%d_", count);
-      properties = xfsm_properties_load (rc, buffer);
-      if (G_UNLIKELY (properties == NULL))
-        {
-          xfsm_verbose ("%s has no properties. Skipping\n", buffer);
-          continue;
-        }
-      if (xfsm_properties_check (properties))
-        g_queue_push_tail (manager->pending_properties, properties);
-      else
+      XfsmProperties *recovered = lp->data;
+
+      found = g_queue_find_custom (manager->pending_properties,
+                                   recovered->client_id,
+                                   (GCompareFunc) xfsm_properties_compare_id);
+      if (found != NULL)
         {
-          xfsm_verbose ("%s has invalid properties. Skipping\n", buffer);
-          xfsm_properties_free (properties);
+          xfsm_verbose ("Client Id = %s is still running, not starting it\n",
+                        recovered->client_id);
+          xfsm_properties_free (found->data);
+          g_queue_delete_link (manager->pending_properties, found);
         }
     }
 
-  xfsm_verbose ("Finished loading clients from rc file\n");
-
   /* load legacy applications */
   xfsm_legacy_load_session (rc);
 
   xfce_rc_close (rc);
 
-  return g_queue_peek_head (manager->pending_properties) != NULL;
+  return g_queue_peek_head (manager->pending_properties) != NULL
+    || g_queue_peek_head (manager->recovered_properties) != NULL;
 }
 
 
@@ -760,16 +1034,50 @@ void
 xfsm_manager_load (XfsmManager   *manager,
                    XfconfChannel *channel)
 {
-  gchar *display_name;
-  gchar *resource_name;
+  GError *error = NULL;
+  gint    autosave_interval;
+  gint    save_concurrency;
+  gchar  *display_name;
+  gchar  *resource_name;
 #ifdef HAVE_OS_CYGWIN
-  gchar *s;
+  gchar  *s;
 #endif
 
   manager->compat_gnome = xfconf_channel_get_bool (channel, "/compat/LaunchGNOME", FALSE);
   manager->compat_kde = xfconf_channel_get_bool (channel, "/compat/LaunchKDE", FALSE);
   manager->start_at = xfconf_channel_get_bool (channel, "/general/StartAssistiveTechnologies", FALSE);
 
+  /* periodically write the running session without asking the clients */
+  autosave_interval = xfconf_channel_get_int (channel, "/general/PeriodicSaveInterval", 0);
+  if (autosave_interval > 0)
+    manager->autosave_interval = MAX (autosave_interval, AUTOSAVE_MIN_INTERVAL);
+
+  manager->fast_logout = xfconf_channel_get_bool (channel, "/general/FastLogout", FALSE);
+  manager->property_signals = xfconf_channel_get_bool (channel, "/general/PerPropertySignals", FALSE);
+
+  manager->freeze_on_lock = xfconf_channel_get_bool (channel, "/general/FreezeOnLock", FALSE);
+  if (manager->freeze_on_lock)
+    {
+      manager->freeze_exempt = xfconf_channel_get_string_list (channel, "/general/FreezeExempt");
+      /* 50 is the priority of normal applications */
+      manager->freeze_min_priority = xfconf_channel_get_int (channel, "/general/FreezeMinPriority", 50);
+      xfsm_manager_watch_screensaver (manager);
+    }
+
+  /* limit the number of clients saving at the same time, 0 is no
+   * limit; saving clients mostly compete for the processors and the
+   * disk, so by default there is one per processor */
+  save_concurrency = xfconf_channel_get_int (channel, "/general/SaveConcurrency", -1);
+  if (save_concurrency < 0)
+    {
+#ifdef _SC_NPROCESSORS_ONLN
+      save_concurrency = MAX (sysconf (_SC_NPROCESSORS_ONLN), SAVE_CONCURRENCY_MIN);
+#else
+      save_concurrency = SAVE_CONCURRENCY_MIN;
+#endif
+    }
+  manager->save_max_outstanding = save_concurrency;
+
   display_name  = xfsm_gdk_display_get_fullname (gdk_display_get_default ());
 
 #ifdef HAVE_OS_CYGWIN
@@ -785,6 +1093,33 @@ xfsm_manager_load (XfsmManager   *manager,
   g_free (resource_name);
   g_free (display_name);
 
+  /* how long clients needed to save in earlier sessions */
+  manager->save_stats_file = xfce_resource_save_location (XFCE_RESOURCE_CACHE,
+                                                          "sessions/xfce4-session-save-times",
+                                                          TRUE);
+  if (manager->save_stats_file != NULL)
+    xfsm_save_stats_load (manager->save_stats, manager->save_stats_file);
+
+  /* bring the session file up to date with what was saved to the
+   * journal in the previous session, before anything reads it */
+  manager->journal = xfsm_journal_new (manager->session_file);
+  if (!xfsm_journal_compact (manager->journal, &error))
+    {
+      g_warning ("Failed to replay the session journal: %s", error->message);
+      g_error_free (error);
+    }
+
+  if (xfsm_deadline_counting_wakeups ())
+    {
+      manager->wakeups_id = xfsm_deadline_add_seconds (60, xfsm_manager_report_wakeups,
+                                                       manager);
+    }
+
+  /* find out whether the previous manager died with clients running */
+  manager->live_file = g_strconcat (manager->session_file, ".live", NULL);
+  manager->live_journal = xfsm_journal_new (manager->live_file);
+  xfsm_manager_recover_live_state (manager);
+
   xfsm_manager_load_settings (manager, channel);
 }
 
@@ -878,6 +1213,7 @@ xfsm_manager_register_client (XfsmManager *manager,
                               const gchar *previous_id)
 {
   XfsmProperties *properties = NULL;
+  const gchar    *interned_id;
   gchar          *client_id;
   GList          *lp;
   SmsConn         sms_conn;
@@ -886,23 +1222,43 @@ xfsm_manager_register_client (XfsmManager *manager,
 
   if (previous_id != NULL)
     {
-      lp = g_queue_find_custom (manager->starting_properties,
-                                previous_id,
-                                (GCompareFunc) xfsm_properties_compare_id);
-      if (lp != NULL)
+      /* ids of known clients are in the string pool, so an id that
+       * is not can't match and the lookups only compare pointers */
+      interned_id = xfsm_intern_lookup (previous_id);
+      if (interned_id != NULL)
         {
-          properties = XFSM_PROPERTIES (lp->data);
-          g_queue_delete_link (manager->starting_properties, lp);
-        }
-      else
-        {
-          lp = g_queue_find_custom (manager->pending_properties,
-                                    previous_id,
+          lp = g_queue_find_custom (manager->starting_properties,
+                                    interned_id,
                                     (GCompareFunc) xfsm_properties_compare_id);
           if (lp != NULL)
             {
               properties = XFSM_PROPERTIES (lp->data);
-              g_queue_delete_link (manager->pending_properties, lp);
+              g_queue_delete_link (manager->starting_properties, lp);
+            }
+          else
+            {
+              lp = g_queue_find_custom (manager->pending_properties,
+                                        interned_id,
+                                        (GCompareFunc) xfsm_properties_compare_id);
+              if (lp != NULL)
+                {
+                  properties = XFSM_PROPERTIES (lp->data);
+                  g_queue_delete_link (manager->pending_properties, lp);
+                }
+            }
+
+          if (properties == NULL)
+            {
+              lp = g_queue_find_custom (manager->recovered_properties,
+                                        interned_id,
+                                        (GCompareFunc) xfsm_properties_compare_id);
+              if (lp != NULL)
+                {
+                  xfsm_verbose ("Client Id = %s survived the previous session "
+                                "manager and registered again\n", previous_id);
+                  properties = XFSM_PROPERTIES (lp->data);
+                  g_queue_delete_link (manager->recovered_properties, lp);
+                }
             }
         }
 
@@ -920,7 +1276,7 @@ xfsm_manager_register_client (XfsmManager *manager,
       /* cancel startup timer */
       if (properties->startup_timeout_id > 0)
         {
-          g_source_remove (properties->startup_timeout_id);
+          xfsm_deadline_remove (properties->startup_timeout_id);
           properties->startup_timeout_id = 0;
         }
 
@@ -934,9 +1290,9 @@ xfsm_manager_register_client (XfsmManager *manager,
        * attempts counter if the client stays alive for a while */
       if (properties->restart_attempts > 0 && properties->restart_attempts_reset_id == 0)
         {
-          properties->restart_attempts_reset_id = g_timeout_add (RESTART_RESET_TIMEOUT,
-                                                                 xfsm_manager_reset_restart_attempts,
-                                                                 properties);
+          properties->restart_attempts_reset_id = xfsm_deadline_add_seconds (RESTART_RESET_TIMEOUT / 1000,
+                                                                             xfsm_manager_reset_restart_attempts,
+                                                                             properties);
         }
     }
   else
@@ -948,6 +1304,7 @@ xfsm_manager_register_client (XfsmManager *manager,
     }
 
   g_queue_push_tail (manager->running_clients, client);
+  xfsm_manager_live_state_changed (manager);
 
   SmsRegisterClientReply (sms_conn, (char *) xfsm_client_get_id (client));
 
@@ -958,6 +1315,7 @@ xfsm_manager_register_client (XfsmManager *manager,
     {
       SmsSaveYourself (sms_conn, SmSaveLocal, False, SmInteractStyleNone, False);
       xfsm_client_set_state (client, XFSM_CLIENT_SAVINGLOCAL);
+      xfsm_manager_save_started (manager, client);
       xfsm_manager_start_client_save_timeout (manager, client);
     }
 
@@ -985,6 +1343,9 @@ xfsm_manager_start_interact (XfsmManager *manager,
   SmsInteract (xfsm_client_get_sms_connection (client));
   xfsm_client_set_state (client, XFSM_CLIENT_INTERACTING);
 
+  /* waiting for the user says nothing about the client's speed */
+  g_hash_table_remove (manager->save_times, client);
+
   /* stop save yourself timeout */
   xfsm_manager_cancel_client_save_timeout (manager, client);
 }
@@ -1091,6 +1452,9 @@ xfsm_manager_interact_done (XfsmManager *manager,
           SmsShutdownCancelled (xfsm_client_get_sms_connection (cl));
         }
 
+      /* clients still waiting for their turn only do a checkpoint */
+      manager->save_shutdown = FALSE;
+
         g_signal_emit (manager, signals[SIG_SHUTDOWN_CANCELLED], 0);
     }
   else
@@ -1114,6 +1478,170 @@ xfsm_manager_interact_done (XfsmManager *manager,
 }
 
 
+static const gchar *
+xfsm_manager_get_client_program (XfsmClient *client)
+{
+  XfsmProperties *properties = xfsm_client_get_properties (client);
+  const gchar    *program;
+  gchar         **argv;
+
+  if (properties == NULL)
+    return NULL;
+
+  program = xfsm_properties_get_string (properties, SmProgram);
+  if (program == NULL)
+    {
+      argv = xfsm_properties_get_strv (properties, SmRestartCommand);
+      if (argv != NULL)
+        program = argv[0];
+    }
+
+  return program;
+}
+
+
+static void
+xfsm_manager_save_started (XfsmManager *manager,
+                           XfsmClient  *client)
+{
+  gint64 *started;
+
+  started = g_new (gint64, 1);
+  *started = g_get_monotonic_time ();
+  g_hash_table_replace (manager->save_times, client, started);
+}
+
+
+static void
+xfsm_manager_save_finished (XfsmManager *manager,
+                            XfsmClient  *client)
+{
+  const gchar *program;
+  gint64      *started;
+
+  started = g_hash_table_lookup (manager->save_times, client);
+  if (started == NULL)
+    return;
+
+  program = xfsm_manager_get_client_program (client);
+  if (program != NULL)
+    {
+      xfsm_save_stats_add (manager->save_stats, program,
+                           (g_get_monotonic_time () - *started) / 1000);
+    }
+
+  g_hash_table_remove (manager->save_times, client);
+}
+
+
+static gint
+xfsm_manager_compare_save_time (gconstpointer a,
+                                gconstpointer b,
+                                gpointer      user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+  guint        time_a = G_MAXUINT;
+  guint        time_b = G_MAXUINT;
+
+  /* clients never seen saving go last, in their original order */
+  xfsm_save_stats_lookup (manager->save_stats,
+                          xfsm_manager_get_client_program ((XfsmClient *) a),
+                          &time_a);
+  xfsm_save_stats_lookup (manager->save_stats,
+                          xfsm_manager_get_client_program ((XfsmClient *) b),
+                          &time_b);
+
+  return time_a < time_b ? -1 : (time_a > time_b ? 1 : 0);
+}
+
+
+static void
+xfsm_manager_save_next (XfsmManager *manager)
+{
+  XfsmClient *client;
+  GList      *lp;
+  guint       n_saving = 0;
+
+  if (g_queue_is_empty (manager->save_queue))
+    return;
+
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      switch (xfsm_client_get_state (lp->data))
+        {
+          case XFSM_CLIENT_SAVING:
+          case XFSM_CLIENT_WAITFORINTERACT:
+          case XFSM_CLIENT_INTERACTING:
+            ++n_saving;
+            break;
+          default:
+            break;
+        }
+    }
+
+  while (manager->save_max_outstanding == 0
+         || n_saving < manager->save_max_outstanding)
+    {
+      client = g_queue_pop_head (manager->save_queue);
+      if (client == NULL)
+        break;
+
+      xfsm_verbose ("Client Id = %s, sending SAVE YOURSELF, %u other clients saving\n",
+                    xfsm_client_get_id (client), n_saving);
+
+      SmsSaveYourself (xfsm_client_get_sms_connection (client),
+                       manager->save_type, manager->save_shutdown,
+                       manager->save_interact_style, manager->save_fast);
+      xfsm_client_set_state (client, XFSM_CLIENT_SAVING);
+      xfsm_manager_save_started (manager, client);
+      xfsm_manager_start_client_save_timeout (manager, client);
+
+      ++n_saving;
+    }
+
+  if (n_saving > manager->save_peak)
+    manager->save_peak = n_saving;
+}
+
+
+static gboolean
+xfsm_manager_client_is_stateless (XfsmClient *client)
+{
+  XfsmProperties *properties = xfsm_client_get_properties (client);
+  const gchar    *desktop_file;
+  gboolean        stateless = FALSE;
+  XfceRc         *rc;
+
+  if (properties == NULL)
+    return FALSE;
+
+  /* set by the client itself or in the session file */
+  if (xfsm_properties_get_uchar (properties, XfsmStateless, 0) != 0)
+    return TRUE;
+
+  /* won't be restarted, so there is no session state to save */
+  if (xfsm_properties_get_uchar (properties, SmRestartStyleHint,
+                                 SmRestartIfRunning) == SmRestartNever)
+    return TRUE;
+
+  desktop_file = xfsm_properties_get_string (properties, GsmDesktopFile);
+  if (desktop_file != NULL)
+    {
+      rc = xfce_rc_simple_open (desktop_file, TRUE);
+      if (rc != NULL)
+        {
+          xfce_rc_set_group (rc, "Desktop Entry");
+          stateless = xfce_rc_read_bool_entry (rc, "X-XFCE-Stateless", FALSE);
+          xfce_rc_close (rc);
+        }
+    }
+
+  return stateless;
+}
+
+
 static void
 xfsm_manager_save_yourself_global (XfsmManager     *manager,
                                    gint             save_type,
@@ -1193,6 +1721,13 @@ xfsm_manager_save_yourself_global (XfsmManager     *manager,
   if (manager->save_session)
       xfsm_legacy_perform_session_save ();
 
+  manager->save_type = save_type;
+  manager->save_shutdown = shutdown;
+  manager->save_interact_style = interact_style;
+  manager->save_fast = fast;
+  manager->save_started = g_get_monotonic_time ();
+  manager->save_peak = 0;
+
   for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
        lp;
        lp = lp->next)
@@ -1207,15 +1742,38 @@ xfsm_manager_save_yourself_global (XfsmManager     *manager,
       if (program != NULL && strcasecmp (program, "xterm") == 0)
         continue;
 
-      if (xfsm_client_get_state (client) != XFSM_CLIENT_SAVINGLOCAL)
+      /* nothing to save, it goes straight to the die phase */
+      if (shutdown
+          && manager->fast_logout
+          && xfsm_client_get_state (client) == XFSM_CLIENT_IDLE
+          && xfsm_manager_client_is_stateless (client))
         {
-          SmsSaveYourself (xfsm_client_get_sms_connection (client), save_type, shutdown,
-                           interact_style, fast);
+          xfsm_verbose ("Client Id = %s is stateless, skipping SAVE YOURSELF\n",
+                        xfsm_client_get_id (client));
+          continue;
         }
 
-      xfsm_client_set_state (client, XFSM_CLIENT_SAVING);
-      xfsm_manager_start_client_save_timeout (manager, client);
+      if (xfsm_client_get_state (client) == XFSM_CLIENT_SAVINGLOCAL)
+        {
+          /* already saving, just wait for it */
+          xfsm_client_set_state (client, XFSM_CLIENT_SAVING);
+          xfsm_manager_start_client_save_timeout (manager, client);
+        }
+      else
+        {
+          xfsm_client_set_state (client, XFSM_CLIENT_WAITFORSAVE);
+          g_queue_push_tail (manager->save_queue, client);
+        }
     }
+
+  /* clients known to save quickly go first, so they are done before
+   * the slow ones hog the disk */
+  g_queue_sort (manager->save_queue, xfsm_manager_compare_save_time, manager);
+  xfsm_manager_save_next (manager);
+
+  /* every client was skipped, no SaveYourselfDone will get us going */
+  if (!xfsm_manager_check_clients_saving (manager))
+    xfsm_manager_complete_saveyourself (manager);
 }
 
 
@@ -1257,6 +1815,7 @@ xfsm_manager_save_yourself (XfsmManager *manager,
        */
       SmsSaveYourself (xfsm_client_get_sms_connection (client), save_type, FALSE, interact_style, fast);
       xfsm_client_set_state (client, XFSM_CLIENT_SAVINGLOCAL);
+      xfsm_manager_save_started (manager, client);
       xfsm_manager_start_client_save_timeout (manager, client);
     }
   else
@@ -1280,6 +1839,10 @@ xfsm_manager_save_yourself_phase2 (XfsmManager *manager,
     {
       xfsm_client_set_state (client, XFSM_CLIENT_WAITFORPHASE2);
       xfsm_manager_cancel_client_save_timeout (manager, client);
+      xfsm_manager_save_finished (manager, client);
+
+      /* phase 1 is done for this one, give its slot to the next */
+      xfsm_manager_save_next (manager);
 
       if (!xfsm_manager_check_clients_saving (manager))
         xfsm_manager_maybe_enter_phase2 (manager);
@@ -1310,6 +1873,7 @@ xfsm_manager_save_yourself_done (XfsmManager *manager,
 
   /* remove client save timeout, as client responded in time */
   xfsm_manager_cancel_client_save_timeout (manager, client);
+  xfsm_manager_save_finished (manager, client);
 
   if (xfsm_client_get_state (client) == XFSM_CLIENT_SAVINGLOCAL)
     {
@@ -1338,10 +1902,20 @@ xfsm_manager_close_connection (XfsmManager *manager,
                                gboolean     cleanup)
 {
   IceConn ice_conn;
-  GList *lp;
+  GPid    frozen_pid;
 
   xfsm_client_set_state (client, XFSM_CLIENT_DISCONNECTED);
   xfsm_manager_cancel_client_save_timeout (manager, client);
+  g_queue_remove (manager->save_queue, client);
+  g_hash_table_remove (manager->save_times, client);
+
+  frozen_pid = GPOINTER_TO_INT (g_hash_table_lookup (manager->frozen_clients, client));
+  if (frozen_pid > 0)
+    {
+      /* let it run into whatever made us lose the connection */
+      kill (frozen_pid, SIGCONT);
+      g_hash_table_remove (manager->frozen_clients, client);
+    }
 
   if (cleanup)
     {
@@ -1354,22 +1928,7 @@ xfsm_manager_close_connection (XfsmManager *manager,
 
   if (manager->state == XFSM_MANAGER_SHUTDOWNPHASE2)
     {
-      for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
-           lp;
-           lp = lp->next)
-        {
-          XfsmClient *cl = lp->data;
-          if (xfsm_client_get_state (cl) != XFSM_CLIENT_DISCONNECTED)
-            return;
-        }
-
-      /* all clients finished the DIE phase in time */
-      if (manager->die_timeout_id)
-        {
-          g_source_remove (manager->die_timeout_id);
-          manager->die_timeout_id = 0;
-        }
-      gtk_main_quit ();
+      xfsm_manager_maybe_finish_die_phase (manager);
     }
   else if (manager->state == XFSM_MANAGER_SHUTDOWN || manager->state == XFSM_MANAGER_CHECKPOINT)
     {
@@ -1390,6 +1949,9 @@ xfsm_manager_close_connection (XfsmManager *manager,
         {
           if (xfsm_properties_check (properties))
             {
+              /* the client is either restarted or gone for good */
+              xfsm_manager_session_changed (manager);
+
               if (xfsm_manager_handle_failed_properties (manager, properties) == FALSE)
                 xfsm_properties_free (properties);
             }
@@ -1451,61 +2013,390 @@ xfsm_manager_terminate_client (XfsmManager *manager,
 }
 
 
-void
-xfsm_manager_perform_shutdown (XfsmManager *manager)
+static void
+xfsm_manager_maybe_finish_die_phase (XfsmManager *manager)
 {
   GList *lp;
 
-  xfsm_verbose ("entering");
+  /* the current die group quit, no need to wait for its deadline */
+  if ((manager->die_group_id != 0 || manager->die_escalate_id != 0)
+      && xfsm_manager_die_group_done (manager))
+    {
+      if (manager->die_group_id != 0)
+        {
+          xfsm_deadline_remove (manager->die_group_id);
+          manager->die_group_id = 0;
+        }
+      if (manager->die_escalate_id != 0)
+        {
+          xfsm_deadline_remove (manager->die_escalate_id);
+          manager->die_escalate_id = 0;
+        }
+      xfsm_manager_die_next_group (manager);
+    }
 
-  /* send SmDie message to all clients */
-  xfsm_manager_set_state (manager, XFSM_MANAGER_SHUTDOWNPHASE2);
   for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
        lp;
        lp = lp->next)
     {
-      XfsmClient *client = lp->data;
-      SmsDie (xfsm_client_get_sms_connection (client));
+      XfsmClient *cl = lp->data;
+      if (xfsm_client_get_state (cl) != XFSM_CLIENT_DISCONNECTED)
+        return;
     }
 
-  /* check for SmRestartAnyway clients that have already quit and
-   * set a ShutdownCommand */
-  for (lp = g_queue_peek_nth_link (manager->restart_properties, 0);
-       lp;
-       lp = lp->next)
+  /* wait for the shutdown commands as well */
+  if (xfsm_command_queue_get_length (manager->shutdown_queue) > 0)
+    return;
+
+  /* all clients finished the DIE phase in time */
+  if (manager->die_timeout_id)
     {
-      XfsmProperties *properties = lp->data;
-      gint            restart_style_hint;
-      gchar         **shutdown_command;
+      xfsm_deadline_remove (manager->die_timeout_id);
+      manager->die_timeout_id = 0;
+    }
+  if (manager->die_escalate_id)
+    {
+      xfsm_deadline_remove (manager->die_escalate_id);
+      manager->die_escalate_id = 0;
+    }
+  if (manager->die_group_id)
+    {
+      xfsm_deadline_remove (manager->die_group_id);
+      manager->die_group_id = 0;
+    }
+  gtk_main_quit ();
+}
 
-      restart_style_hint = xfsm_properties_get_uchar (properties,
-                                                      SmRestartStyleHint,
-                                                      SmRestartIfRunning);
-      shutdown_command = xfsm_properties_get_strv (properties, SmShutdownCommand);
 
-      if (restart_style_hint == SmRestartAnyway && shutdown_command != NULL)
-        {
-          xfsm_verbose ("Client Id = %s, quit already, running shutdown command.\n\n",
-                        properties->client_id);
+static GPid
+xfsm_manager_get_properties_pid (XfsmProperties *properties)
+{
+  const gchar    *pid_str;
+  gchar          *end;
+  glong           pid;
 
-          g_spawn_sync (xfsm_properties_get_string (properties, SmCurrentDirectory),
-                        shutdown_command,
-                        xfsm_properties_get_strv (properties, SmEnvironment),
-                        G_SPAWN_SEARCH_PATH,
-                        NULL, NULL,
-                        NULL, NULL,
-                        NULL, NULL);
-        }
-    }
+  /* only trust the SmProcessID of clients on this machine */
+  if (properties == NULL
+      || properties->hostname == NULL
+      || strncmp (properties->hostname, "local/", 6) != 0)
+    return 0;
+
+  pid_str = xfsm_properties_get_string (properties, SmProcessID);
+  if (pid_str == NULL)
+    return 0;
 
-  /* give all clients the chance to close the connection */
-  manager->die_timeout_id = g_timeout_add (DIE_TIMEOUT,
-                                           (GSourceFunc) gtk_main_quit,
-                                           NULL);
+  pid = strtol (pid_str, &end, 10);
+  if (end == pid_str || *end != '\0' || pid <= 1 || pid > G_MAXINT
+      || pid == (glong) getpid ())
+    return 0;
+
+  return (GPid) pid;
 }
 
 
-gboolean
+static GPid
+xfsm_manager_get_client_pid (XfsmClient *client)
+{
+  return xfsm_manager_get_properties_pid (xfsm_client_get_properties (client));
+}
+
+
+static void
+xfsm_manager_shutdown_command_done (const gchar *client_id,
+                                    gchar      **command,
+                                    gint         exit_status,
+                                    gboolean     timed_out,
+                                    gpointer     user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+
+  if (timed_out)
+    {
+      g_warning ("Shutdown command \"%s\" of client %s overran its deadline",
+                 *command, client_id);
+      manager->shutdown_overruns++;
+    }
+
+  xfsm_verbose ("Client Id = %s, shutdown command %s finished "
+                "[Exit status = %d, Timed out = %s]\n\n",
+                client_id, *command, exit_status,
+                timed_out ? "yes" : "no");
+
+  if (xfsm_command_queue_get_length (manager->shutdown_queue) > 0)
+    return;
+
+  xfsm_verbose ("All shutdown commands finished, %u overran their deadline\n\n",
+                manager->shutdown_overruns);
+
+  if (manager->state == XFSM_MANAGER_SHUTDOWNPHASE2)
+    xfsm_manager_maybe_finish_die_phase (manager);
+}
+
+
+static gboolean
+xfsm_manager_die_timeout (gpointer user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+
+  xfsm_verbose ("Not all clients finished the DIE phase in time, "
+                "leaving the main loop now.\n\n");
+
+  manager->die_timeout_id = 0;
+
+  if (manager->die_escalate_id != 0)
+    {
+      xfsm_deadline_remove (manager->die_escalate_id);
+      manager->die_escalate_id = 0;
+    }
+  if (manager->die_group_id != 0)
+    {
+      xfsm_deadline_remove (manager->die_group_id);
+      manager->die_group_id = 0;
+    }
+
+  /* the global deadline for the shutdown commands is the same as
+   * for the clients, whatever is still running now is reported and
+   * killed */
+  xfsm_command_queue_abort (manager->shutdown_queue);
+
+  gtk_main_quit ();
+
+  return FALSE;
+}
+
+
+static gint
+xfsm_manager_get_client_priority (XfsmClient *client)
+{
+  XfsmProperties *properties = xfsm_client_get_properties (client);
+
+  if (properties == NULL)
+    return 50;
+
+  return properties->priority;
+}
+
+
+static gboolean
+xfsm_manager_die_group_done (XfsmManager *manager)
+{
+  GList *lp;
+
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      XfsmClient *client = lp->data;
+
+      if (xfsm_client_get_state (client) != XFSM_CLIENT_DISCONNECTED
+          && xfsm_manager_get_client_priority (client) == manager->die_priority)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+/* sends @signal_number to the local clients of the current die group
+ * that are still connected, returns whether there were any */
+static gboolean
+xfsm_manager_die_group_signal (XfsmManager *manager,
+                               gint         signal_number)
+{
+  gboolean signalled = FALSE;
+  GList   *lp;
+  GPid     pid;
+
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      XfsmClient *client = lp->data;
+
+      if (xfsm_client_get_state (client) == XFSM_CLIENT_DISCONNECTED
+          || xfsm_manager_get_client_priority (client) != manager->die_priority)
+        continue;
+
+      pid = xfsm_manager_get_client_pid (client);
+      if (pid == 0)
+        continue;
+
+      xfsm_verbose ("Client Id = %s, did not quit after DIE, sending %s to pid %d\n\n",
+                    xfsm_client_get_id (client),
+                    signal_number == SIGTERM ? "SIGTERM" : "SIGKILL",
+                    (gint) pid);
+
+      kill (pid, signal_number);
+      signalled = TRUE;
+    }
+
+  return signalled;
+}
+
+
+static gboolean
+xfsm_manager_die_escalate (gpointer user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+
+  manager->die_escalate_id = 0;
+
+  xfsm_manager_die_group_signal (manager, SIGKILL);
+  xfsm_manager_die_next_group (manager);
+
+  return FALSE;
+}
+
+
+static gboolean
+xfsm_manager_die_group_timeout (gpointer user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+
+  xfsm_verbose ("Not all clients in die group %d quit in time\n\n",
+                manager->die_priority);
+
+  manager->die_group_id = 0;
+
+  /* local clients of the group that ignore the DIE message get SIGTERM
+   * and then SIGKILL before the next group is told to quit, the others
+   * are left to the DIE_TIMEOUT */
+  if (xfsm_manager_die_group_signal (manager, SIGTERM))
+    {
+      manager->die_escalate_id = xfsm_deadline_add (manager->die_escalate_timeout,
+                                                    xfsm_manager_die_escalate,
+                                                    manager);
+      return FALSE;
+    }
+
+  xfsm_manager_die_next_group (manager);
+
+  return FALSE;
+}
+
+
+static void
+xfsm_manager_die_next_group (XfsmManager *manager)
+{
+  GList   *lp;
+  gint     priority = -1;
+  gint     n;
+  gboolean last = TRUE;
+  gint64   remaining;
+  guint    group_timeout;
+
+  /* clients are told to quit in the reverse order they were started in:
+   * applications first, the panel and desktop later and the window
+   * manager last, so nothing has to reparent or re-embed the windows of
+   * clients that are about to go away anyway */
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      XfsmClient *client = lp->data;
+
+      if (xfsm_client_get_state (client) == XFSM_CLIENT_DISCONNECTED)
+        continue;
+
+      n = xfsm_manager_get_client_priority (client);
+      if (n < manager->die_priority && n > priority)
+        priority = n;
+    }
+
+  if (priority < 0)
+    {
+      xfsm_verbose ("All die groups done\n\n");
+      return;
+    }
+
+  manager->die_priority = priority;
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      XfsmClient *client = lp->data;
+
+      if (xfsm_client_get_state (client) == XFSM_CLIENT_DISCONNECTED)
+        continue;
+
+      n = xfsm_manager_get_client_priority (client);
+      if (n == priority)
+        SmsDie (xfsm_client_get_sms_connection (client));
+      else if (n < priority)
+        last = FALSE;
+    }
+
+  /* the applications, which are told first, are the ones that may
+   * still have to write something, the session components usually
+   * quit right away */
+  remaining = (manager->die_deadline - g_get_monotonic_time ()) / 1000;
+  group_timeout = MAX (last ? remaining : remaining / 2, DIE_GROUP_TIMEOUT_MIN);
+  manager->die_escalate_timeout = group_timeout / 3;
+
+  xfsm_verbose ("Sent DIE to clients in die group %d, waiting %u ms\n\n",
+                priority, group_timeout);
+
+  manager->die_group_id = xfsm_deadline_add (group_timeout - manager->die_escalate_timeout,
+                                             xfsm_manager_die_group_timeout,
+                                             manager);
+}
+
+
+void
+xfsm_manager_perform_shutdown (XfsmManager *manager)
+{
+  GList *lp;
+
+  xfsm_verbose ("entering");
+
+  xfsm_manager_set_state (manager, XFSM_MANAGER_SHUTDOWNPHASE2);
+
+  /* check for SmRestartAnyway clients that have already quit and
+   * set a ShutdownCommand */
+  for (lp = g_queue_peek_nth_link (manager->restart_properties, 0);
+       lp;
+       lp = lp->next)
+    {
+      XfsmProperties *properties = lp->data;
+      gint            restart_style_hint;
+      gchar         **shutdown_command;
+
+      restart_style_hint = xfsm_properties_get_uchar (properties,
+                                                      SmRestartStyleHint,
+                                                      SmRestartIfRunning);
+      shutdown_command = xfsm_properties_get_strv (properties, SmShutdownCommand);
+
+      if (restart_style_hint == SmRestartAnyway && shutdown_command != NULL)
+        {
+          xfsm_verbose ("Client Id = %s, quit already, running shutdown command.\n\n",
+                        properties->client_id);
+
+          xfsm_command_queue_push (manager->shutdown_queue,
+                                   properties->client_id,
+                                   xfsm_properties_get_string (properties, SmCurrentDirectory),
+                                   shutdown_command,
+                                   xfsm_properties_get_strv (properties, SmEnvironment));
+        }
+    }
+
+  /* give all clients the chance to close the connection, and the
+   * shutdown commands the chance to finish; the deadline is for the
+   * whole DIE phase, not per die group */
+  manager->die_timeout_id = xfsm_deadline_add (DIE_TIMEOUT,
+                                               xfsm_manager_die_timeout,
+                                               manager);
+  manager->die_deadline = g_get_monotonic_time () + (gint64) DIE_TIMEOUT * 1000;
+
+  /* send SmDie message to all clients, one priority group at a time */
+  manager->die_priority = G_MAXINT;
+  xfsm_manager_die_next_group (manager);
+
+  /* nothing to wait for, e.g. no clients are running */
+  xfsm_manager_maybe_finish_die_phase (manager);
+}
+
+
+gboolean
 xfsm_manager_check_clients_saving (XfsmManager *manager)
 {
   GList *lp;
@@ -1521,6 +2412,7 @@ xfsm_manager_check_clients_saving (XfsmManager *manager)
           case XFSM_CLIENT_SAVING:
           case XFSM_CLIENT_WAITFORINTERACT:
           case XFSM_CLIENT_INTERACTING:
+          case XFSM_CLIENT_WAITFORSAVE:
             return TRUE;
           default:
             break;
@@ -1564,13 +2456,19 @@ xfsm_manager_complete_saveyourself (XfsmManager *manager)
 {
   GList *lp;
 
+  /* a client finished or went away, so there may be room for more */
+  xfsm_manager_save_next (manager);
+
   /* Check if still clients in SAVING state or if we have to enter PHASE2
    * now. In either case, SaveYourself cannot be completed in this run.
    */
   if (xfsm_manager_check_clients_saving (manager) || xfsm_manager_maybe_enter_phase2 (manager))
     return;
 
-  xfsm_verbose ("Manager finished SAVE YOURSELF, session data will be stored now.\n\n");
+  xfsm_verbose ("Manager finished SAVE YOURSELF in %" G_GINT64_FORMAT " ms, with at most "
+                "%u clients saving at a time, session data will be stored now.\n\n",
+                (g_get_monotonic_time () - manager->save_started) / 1000,
+                manager->save_peak);
 
   /* all clients done, store session data */
   if (manager->save_session)
@@ -1609,6 +2507,9 @@ xfsm_manager_save_timeout (gpointer user_data)
   /* returning FALSE below will free the data */
   g_object_steal_data (G_OBJECT (stdata->client), "--save-timeout-id");
 
+  /* counts as a (long) save, so a slow client gets more time next time */
+  xfsm_manager_save_finished (stdata->manager, stdata->client);
+
   xfsm_manager_close_connection (stdata->manager, stdata->client, TRUE);
 
   return FALSE;
@@ -1620,19 +2521,30 @@ xfsm_manager_start_client_save_timeout (XfsmManager *manager,
                                         XfsmClient  *client)
 {
   XfsmSaveTimeoutData *sdata = g_new(XfsmSaveTimeoutData, 1);
+  guint                timeout = SAVE_TIMEOUT;
+
+  /* a save we measure, as opposed to phase 2 or the rest of a save
+   * after interacting with the user, gets a timeout that fits the
+   * history of the program */
+  if (g_hash_table_lookup (manager->save_times, client) != NULL)
+    {
+      timeout = xfsm_save_stats_get_timeout (manager->save_stats,
+                                             xfsm_manager_get_client_program (client),
+                                             SAVE_TIMEOUT_MIN, SAVE_TIMEOUT);
+    }
 
   sdata->manager = manager;
   sdata->client = client;
-  /* |sdata| will get freed when the source gets removed */
-  sdata->timeout_id = g_timeout_add_full (G_PRIORITY_DEFAULT, SAVE_TIMEOUT,
-                                          xfsm_manager_save_timeout,
-                                          sdata, (GDestroyNotify) g_free);
-  /* ... or, if the object gets destroyed first, the source will get
+  /* |sdata| will get freed when the deadline gets removed */
+  sdata->timeout_id = xfsm_deadline_add_full (timeout,
+                                              xfsm_manager_save_timeout,
+                                              sdata, (GDestroyNotify) g_free);
+  /* ... or, if the object gets destroyed first, the deadline will get
    * removed and will free |sdata| for us.  also, if there's a pending
    * timer, this call will clear it. */
   g_object_set_data_full (G_OBJECT (client), "--save-timeout-id",
                           GUINT_TO_POINTER (sdata->timeout_id),
-                          (GDestroyNotify) g_source_remove);
+                          (GDestroyNotify) xfsm_deadline_remove);
 }
 
 
@@ -1640,63 +2552,112 @@ static void
 xfsm_manager_cancel_client_save_timeout (XfsmManager *manager,
                                          XfsmClient  *client)
 {
-  /* clearing out the data will call g_source_remove(), which will free it */
+  /* clearing out the data will call xfsm_deadline_remove(), which will free it */
   g_object_set_data (G_OBJECT (client), "--save-timeout-id", NULL);
 }
 
 
+static void
+xfsm_manager_discard_done (const gchar *client_id,
+                           gchar      **command,
+                           gint         exit_status,
+                           gboolean     timed_out,
+                           gpointer     user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+  gchar       *command_line;
+
+  xfsm_verbose ("Client Id = %s, discard command %s finished "
+                "[Exit status = %d, Timed out = %s]\n\n",
+                client_id, *command, exit_status,
+                timed_out ? "yes" : "no");
+
+  command_line = g_strjoinv (" ", command);
+  g_signal_emit (manager, signals[SIG_DISCARD_COMMAND_FINISHED], 0,
+                 client_id, command_line, exit_status, timed_out);
+  g_free (command_line);
+}
+
+
+void
+xfsm_manager_run_discard_command (XfsmManager    *manager,
+                                  XfsmProperties *properties,
+                                  gchar         **discard_command)
+{
+  g_return_if_fail (XFSM_IS_MANAGER (manager));
+  g_return_if_fail (properties != NULL);
+
+  if (discard_command == NULL || *discard_command == NULL)
+    return;
+
+  xfsm_verbose ("Client Id = %s: queueing discard command %s:%d.\n\n",
+                properties->client_id, *discard_command,
+                g_strv_length (discard_command));
+
+  /* the queue copies everything, |properties| may go away right after */
+  xfsm_command_queue_push (manager->discard_queue,
+                           properties->client_id,
+                           xfsm_properties_get_string (properties, SmCurrentDirectory),
+                           discard_command,
+                           xfsm_properties_get_strv (properties, SmEnvironment));
+}
+
+
+static void
+xfsm_manager_store_session_done (gboolean      succeed,
+                                 const GError *error,
+                                 gpointer      user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+
+  if (succeed)
+    return;
+
+  fprintf (stderr,
+           "xfce4-session: Unable to store session data in %s: %s. "
+           "Please check your installation.\n",
+           manager->session_file, error->message);
+}
+
+
 void
 xfsm_manager_store_session (XfsmManager *manager)
 {
-  WnckWorkspace *workspace;
   GdkDisplay    *display;
-  WnckScreen    *screen;
-  XfceRc        *rc;
+  XfsmSnapshot  *snapshot;
   GList         *lp;
   gchar          prefix[64];
-  gchar         *backup;
-  gchar         *group;
-  gint           count = 0;
-  gint           n, m;
-
-  /* open file for writing, creates it if it doesn't exist */
-  rc = xfce_rc_simple_open (manager->session_file, FALSE);
-  if (G_UNLIKELY (rc == NULL))
-    {
-      fprintf (stderr,
-               "xfce4-session: Unable to open session file %s for "
-               "writing. Session data will not be stored. Please check "
-               "your installation.\n",
-               manager->session_file);
-      return;
-    }
+  glong          m;
+  gint           n;
 
-  /* backup the old session file first */
-  if (g_file_test (manager->session_file, G_FILE_TEST_IS_REGULAR))
+  /* everything up to here is saved, clients may dirty it again */
+  manager->session_dirty = FALSE;
+  if (manager->autosave_id != 0)
     {
-      backup = g_strconcat (manager->session_file, ".bak", NULL);
-      unlink (backup);
-      if (link (manager->session_file, backup))
-          g_warning ("Failed to create session file backup");
-      g_free (backup);
+      xfsm_deadline_remove (manager->autosave_id);
+      manager->autosave_id = 0;
     }
 
   if (manager->state == XFSM_MANAGER_CHECKPOINT && manager->checkpoint_session_name != NULL)
-    group = g_strconcat ("Session: ", manager->checkpoint_session_name, NULL);
+    snapshot = xfsm_snapshot_new (manager->checkpoint_session_name);
   else
-    group = g_strconcat ("Session: ", manager->session_name, NULL);
-  xfce_rc_delete_group (rc, group, TRUE);
-  xfce_rc_set_group (rc, group);
-  g_free (group);
+    snapshot = xfsm_snapshot_new (manager->session_name);
 
   for (lp = g_queue_peek_nth_link (manager->restart_properties, 0);
        lp;
        lp = lp->next)
     {
       XfsmProperties *properties = lp->data;
-      g_snprintf (prefix, 64, "Client%d_", count);
-      xfsm_properties_store (properties, rc, prefix);
-      ++count;
+      xfsm_properties_store (properties, snapshot);
+    }
+
+  /* still running, even though they did not talk to us again */
+  for (lp = g_queue_peek_nth_link (manager->recovered_properties, 0);
+       lp;
+       lp = lp->next)
+    {
+      XfsmProperties *properties = lp->data;
+      xfsm_properties_store (properties, snapshot);
     }
 
   for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
@@ -1715,40 +2676,616 @@ xfsm_manager_store_session (XfsmManager *manager)
       if (restart_style_hint == SmRestartNever)
         continue;
 
-      g_snprintf (prefix, 64, "Client%d_", count);
-      xfsm_properties_store (xfsm_client_get_properties (client), rc, prefix);
-      ++count;
+      xfsm_properties_store (xfsm_client_get_properties (client), snapshot);
     }
 
-  xfce_rc_write_int_entry (rc, "Count", count);
-
   /* store legacy applications state */
-  xfsm_legacy_store_session (rc);
+  xfsm_legacy_store_session (snapshot);
 
   /* store current workspace numbers */
   display = gdk_display_get_default ();
+  xfsm_manager_intern_atoms (GDK_DISPLAY_XDISPLAY (display));
   for (n = 0; n < gdk_display_get_n_screens (display); ++n)
     {
-      screen = wnck_screen_get (n);
-      wnck_screen_force_update (screen);
-
-      workspace = wnck_screen_get_active_workspace (screen);
-      m = wnck_workspace_get_number (workspace);
+      /* nothing to remember without an EWMH window manager */
+      if (!xfsm_manager_get_root_cardinal (gdk_display_get_screen (display, n),
+                                           _NET_CURRENT_DESKTOP, &m))
+        continue;
 
       g_snprintf (prefix, 64, "Screen%d_ActiveWorkspace", n);
-      xfce_rc_write_int_entry (rc, prefix, m);
+      xfsm_snapshot_write_int_entry (snapshot, prefix, m);
     }
 
   /* remember time */
-  xfce_rc_write_int_entry (rc, "LastAccess", time (NULL));
+  xfsm_snapshot_write_int_entry (snapshot, "LastAccess", time (NULL));
 
-  xfce_rc_close (rc);
+  /* only what changed since the last save goes to disk, the writer
+   * thread owns |snapshot| from here on */
+  xfsm_journal_commit (manager->journal, snapshot,
+                       xfsm_manager_store_session_done, manager);
+
+  /* leave a complete session file behind at logout, the journal is
+   * waited for before we exit */
+  if (manager->state == XFSM_MANAGER_SHUTDOWN
+      || manager->state == XFSM_MANAGER_SHUTDOWNPHASE2)
+    xfsm_journal_compact_async (manager->journal);
 
   g_free (manager->checkpoint_session_name);
   manager->checkpoint_session_name = NULL;
 }
 
 
+static gboolean
+xfsm_manager_autosave (gpointer user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+
+  /* clients are still coming up, try again later */
+  if (manager->state == XFSM_MANAGER_STARTUP)
+    return TRUE;
+
+  manager->autosave_id = 0;
+
+  /* a checkpoint or the logout stores the session itself */
+  if (manager->state != XFSM_MANAGER_IDLE || !manager->session_dirty)
+    return FALSE;
+
+  xfsm_verbose ("Autosaving session \"%s\"\n\n", manager->session_name);
+
+  /* no SaveYourself round, this stores what the clients told us last */
+  xfsm_manager_store_session (manager);
+
+  return FALSE;
+}
+
+
+/**
+ * xfsm_manager_session_changed:
+ * @manager : an #XfsmManager.
+ *
+ * Marks the running session as changed since it was last stored.  If
+ * autosave is enabled, the session is stored at the latest
+ * autosave_interval seconds later; further changes in the meantime
+ * are picked up by the same write.
+ **/
+void
+xfsm_manager_session_changed (XfsmManager *manager)
+{
+  g_return_if_fail (XFSM_IS_MANAGER (manager));
+
+  manager->session_dirty = TRUE;
+  xfsm_manager_live_state_changed (manager);
+
+  if (manager->autosave_interval == 0 || manager->autosave_id != 0)
+    return;
+
+  manager->autosave_id = xfsm_deadline_add_seconds (manager->autosave_interval,
+                                                    xfsm_manager_autosave, manager);
+}
+
+
+static gboolean
+xfsm_manager_report_wakeups (gpointer user_data)
+{
+  XfsmManager *manager = XFSM_MANAGER (user_data);
+  guint        n_wakeups;
+
+  n_wakeups = xfsm_deadline_reset_wakeups ();
+
+  /* only minutes we spent entirely in the idle state are of interest */
+  if (manager->wakeups_idle)
+    g_message ("%u main loop wakeups in the last idle minute", n_wakeups);
+
+  manager->wakeups_idle = manager->state == XFSM_MANAGER_IDLE;
+
+  return TRUE;
+}
+
+
+/* identifies this boot, so the pids of a live state file that survived
+ * a reboot or power loss are not mistaken for our clients */
+static gchar*
+xfsm_manager_get_boot_id (void)
+{
+  gchar *boot_id;
+
+  if (!g_file_get_contents ("/proc/sys/kernel/random/boot_id", &boot_id, NULL, NULL))
+    return NULL;
+
+  return g_strstrip (boot_id);
+}
+
+
+/* the start time of |pid| in clock ticks since boot, field 22 of
+ * /proc/<pid>/stat; together with the boot id this tells whether a pid
+ * still belongs to the same process, since pids are reused */
+static gchar*
+xfsm_manager_get_process_start_time (GPid pid)
+{
+  gchar  filename[64];
+  gchar *contents;
+  gchar *start_time = NULL;
+  gchar *p;
+  gchar *end;
+  gint   field;
+
+  g_snprintf (filename, sizeof (filename), "/proc/%d/stat", (gint) pid);
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    return NULL;
+
+  /* the command name in field 2 may contain spaces and parentheses */
+  p = strrchr (contents, ')');
+  for (field = 2; p != NULL && field < 22; ++field)
+    p = strchr (p + 1, ' ');
+
+  if (p != NULL)
+    {
+      for (end = ++p; g_ascii_isdigit (*end); ++end)
+        ;
+      if (end > p)
+        start_time = g_strndup (p, end - p);
+    }
+
+  g_free (contents);
+
+  return start_time;
+}
+
+
+static void
+xfsm_manager_remove_live_state (XfsmManager *manager)
+{
+  gchar *journal_file;
+  gchar *backup_file;
+
+  journal_file = g_strconcat (manager->live_file, ".journal", NULL);
+  if (unlink (journal_file) < 0 && errno != ENOENT)
+    g_warning ("Failed to remove %s: %s", journal_file, g_strerror (errno));
+  g_free (journal_file);
+
+  /* left behind by the compaction of the journal */
+  backup_file = g_strconcat (manager->live_file, ".bak", NULL);
+  if (unlink (backup_file) < 0 && errno != ENOENT)
+    g_warning ("Failed to remove %s: %s", backup_file, g_strerror (errno));
+  g_free (backup_file);
+
+  if (unlink (manager->live_file) < 0 && errno != ENOENT)
+    g_warning ("Failed to remove %s: %s", manager->live_file, g_strerror (errno));
+}
+
+
+static void
+xfsm_manager_store_live_client (XfsmProperties *properties,
+                                XfsmSnapshot   *snapshot)
+{
+  XfsmSnapshotClient *entry;
+  const gchar        *pid;
+  gchar              *start_time;
+  GPid                client_pid;
+
+  xfsm_properties_store (properties, snapshot);
+
+  /* what tells us after a crash whether the client is still there */
+  client_pid = xfsm_manager_get_properties_pid (properties);
+  if (client_pid <= 0)
+    return;
+
+  start_time = xfsm_manager_get_process_start_time (client_pid);
+  if (start_time == NULL)
+    return;
+
+  pid = xfsm_properties_get_string (properties, SmProcessID);
+  entry = xfsm_snapshot_lookup_client (snapshot, properties->client_id);
+  xfsm_snapshot_client_write_entry (entry, "ProcessId", pid);
+  xfsm_snapshot_client_write_entry (entry, "ProcessStartTime", start_time);
+  g_free (start_time);
+}
+
+
+static gboolean
+xfsm_manager_store_live_state (gpointer user_data)
+{
+  XfsmManager    *manager = XFSM_MANAGER (user_data);
+  XfsmSnapshot   *snapshot;
+  XfsmProperties *properties;
+  gchar          *boot_id;
+  GList          *lp;
+
+  manager->live_update_id = 0;
+
+  snapshot = xfsm_snapshot_new (LIVE_SESSION_NAME);
+
+  boot_id = xfsm_manager_get_boot_id ();
+  if (boot_id != NULL)
+    {
+      xfsm_snapshot_write_entry (snapshot, "BootId", boot_id);
+      g_free (boot_id);
+    }
+
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      properties = xfsm_client_get_properties (lp->data);
+      if (properties == NULL || !xfsm_properties_check (properties))
+        continue;
+
+      xfsm_manager_store_live_client (properties, snapshot);
+    }
+
+  for (lp = g_queue_peek_nth_link (manager->recovered_properties, 0);
+       lp;
+       lp = lp->next)
+    {
+      xfsm_manager_store_live_client (lp->data, snapshot);
+    }
+
+  /* only the clients that changed are appended, by the writer thread */
+  xfsm_journal_commit (manager->live_journal, snapshot, NULL, NULL);
+
+  return FALSE;
+}
+
+
+/**
+ * xfsm_manager_live_state_changed:
+ * @manager : an #XfsmManager.
+ *
+ * Schedules an update of the live state file after a client came,
+ * went or changed its properties.
+ **/
+void
+xfsm_manager_live_state_changed (XfsmManager *manager)
+{
+  g_return_if_fail (XFSM_IS_MANAGER (manager));
+
+  if (manager->live_journal == NULL || manager->live_update_id != 0)
+    return;
+
+  /* nothing to recover once we are going away */
+  if (manager->state == XFSM_MANAGER_SHUTDOWN
+      || manager->state == XFSM_MANAGER_SHUTDOWNPHASE2)
+    return;
+
+  manager->live_update_id = xfsm_deadline_add_seconds (LIVE_STATE_DELAY / 1000,
+                                                       xfsm_manager_store_live_state,
+                                                       manager);
+}
+
+
+/* reads what a crashed manager left behind, the clients that are still
+ * alive wait in |recovered_properties| for their new registration */
+static void
+xfsm_manager_recover_live_state (XfsmManager *manager)
+{
+  XfsmProperties *properties;
+  const gchar    *pid;
+  const gchar    *start_time;
+  GError         *error = NULL;
+  XfceRc         *rc;
+  gchar           buffer[256];
+  gchar          *boot_id;
+  gchar          *current_start_time;
+  gboolean        same_boot;
+  gboolean        alive;
+  gint64          started;
+  guint           n_alive = 0;
+  guint           n_lost = 0;
+  gint            count;
+  GPid            client_pid;
+
+  started = g_get_monotonic_time ();
+
+  /* replays the journal of the previous manager into the live file */
+  if (!xfsm_journal_compact (manager->live_journal, &error))
+    {
+      g_warning ("Failed to replay the live state journal: %s", error->message);
+      g_error_free (error);
+    }
+
+  if (!g_file_test (manager->live_file, G_FILE_TEST_IS_REGULAR))
+    return;
+
+  rc = xfce_rc_simple_open (manager->live_file, TRUE);
+  if (G_UNLIKELY (rc == NULL))
+    {
+      xfsm_manager_remove_live_state (manager);
+      return;
+    }
+
+  xfce_rc_set_group (rc, "Session: " LIVE_SESSION_NAME);
+  count = xfce_rc_read_int_entry (rc, "Count", 0);
+
+  /* after a reboot none of the pids are ours anymore */
+  boot_id = xfsm_manager_get_boot_id ();
+  same_boot = (boot_id != NULL
+               && g_strcmp0 (xfce_rc_read_entry (rc, "BootId", NULL), boot_id) == 0);
+  g_free (boot_id);
+
+  while (count-- > 0)
+    {
+      g_snprintf (buffer, sizeof (buffer), "Client%d_", count);
+      properties = xfsm_properties_load (rc, buffer);
+      if (G_UNLIKELY (properties == NULL))
+        continue;
+
+      g_snprintf (buffer, sizeof (buffer), "Client%d_ProcessId", count);
+      pid = xfce_rc_read_entry (rc, buffer, NULL);
+      if (pid != NULL)
+        xfsm_properties_set_string (properties, SmProcessID, pid);
+
+      g_snprintf (buffer, sizeof (buffer), "Client%d_ProcessStartTime", count);
+      start_time = xfce_rc_read_entry (rc, buffer, NULL);
+
+      /* only a pid that still belongs to the same process is trusted,
+       * and nothing is sent to pids that are not */
+      alive = FALSE;
+      client_pid = xfsm_manager_get_properties_pid (properties);
+      if (same_boot && client_pid > 0 && start_time != NULL)
+        {
+          current_start_time = xfsm_manager_get_process_start_time (client_pid);
+          alive = (g_strcmp0 (current_start_time, start_time) == 0);
+          g_free (current_start_time);
+        }
+
+      if (alive)
+        {
+          xfsm_verbose ("Client Id = %s (pid %d) survived the previous "
+                        "session manager\n", properties->client_id, client_pid);
+
+          /* in case the screen was locked when we died */
+          kill (client_pid, SIGCONT);
+          g_queue_push_tail (manager->recovered_properties, properties);
+          n_alive++;
+        }
+      else
+        {
+          xfsm_verbose ("Client Id = %s did not survive the previous "
+                        "session manager\n", properties->client_id);
+          xfsm_properties_free (properties);
+          n_lost++;
+        }
+    }
+
+  xfce_rc_close (rc);
+
+  /* start over, the surviving clients are written again right away */
+  xfsm_manager_remove_live_state (manager);
+  if (n_alive > 0)
+    xfsm_manager_live_state_changed (manager);
+
+  g_message ("The previous session manager did not exit cleanly: "
+             "%u clients still running, %u lost, recovered in %"
+             G_GINT64_FORMAT " ms", n_alive, n_lost,
+             (g_get_monotonic_time () - started) / 1000);
+}
+
+
+static gboolean
+xfsm_manager_is_freeze_exempt (XfsmManager *manager,
+                               XfsmClient  *client)
+{
+  const gchar *program;
+  gchar       *basename;
+  gboolean     exempt = FALSE;
+  guint        n;
+
+  /* the session's own desktop components keep running */
+  if (xfsm_manager_get_client_priority (client) < manager->freeze_min_priority)
+    return TRUE;
+
+  if (manager->freeze_exempt == NULL)
+    return FALSE;
+
+  program = xfsm_manager_get_client_program (client);
+  if (program == NULL)
+    return FALSE;
+
+  basename = g_path_get_basename (program);
+  for (n = 0; !exempt && manager->freeze_exempt[n] != NULL; ++n)
+    exempt = strcmp (basename, manager->freeze_exempt[n]) == 0
+      || strcmp (program, manager->freeze_exempt[n]) == 0;
+  g_free (basename);
+
+  return exempt;
+}
+
+
+static void
+xfsm_manager_freeze_clients (XfsmManager *manager)
+{
+  XfsmClient *client;
+  GList      *lp;
+  GPid        pid;
+  guint       n_frozen = 0;
+
+  if (!manager->freeze_on_lock
+      || !manager->screensaver_active
+      || manager->state != XFSM_MANAGER_IDLE)
+    return;
+
+  for (lp = g_queue_peek_nth_link (manager->running_clients, 0);
+       lp;
+       lp = lp->next)
+    {
+      client = XFSM_CLIENT (lp->data);
+
+      if (xfsm_client_get_state (client) != XFSM_CLIENT_IDLE
+          || g_hash_table_lookup (manager->frozen_clients, client) != NULL
+          || xfsm_manager_is_freeze_exempt (manager, client))
+        continue;
+
+      /* only processes on this machine we know the pid of */
+      pid = xfsm_manager_get_client_pid (client);
+      if (pid <= 0 || pid == manager->screensaver_pid)
+        continue;
+
+      if (kill (pid, SIGSTOP) < 0)
+        {
+          xfsm_verbose ("Client Id = %s, failed to stop pid %d: %s\n",
+                        xfsm_client_get_id (client), pid, g_strerror (errno));
+          continue;
+        }
+
+      g_hash_table_insert (manager->frozen_clients, client, GINT_TO_POINTER (pid));
+      n_frozen++;
+    }
+
+  xfsm_verbose ("Screen locked, stopped %u clients\n", n_frozen);
+}
+
+
+static void
+xfsm_manager_thaw_clients (XfsmManager *manager)
+{
+  GHashTableIter iter;
+  gpointer       pid;
+
+  if (g_hash_table_size (manager->frozen_clients) == 0)
+    return;
+
+  xfsm_verbose ("Continuing %u stopped clients\n",
+                g_hash_table_size (manager->frozen_clients));
+
+  g_hash_table_iter_init (&iter, manager->frozen_clients);
+  while (g_hash_table_iter_next (&iter, NULL, &pid))
+    kill (GPOINTER_TO_INT (pid), SIGCONT);
+
+  g_hash_table_remove_all (manager->frozen_clients);
+}
+
+
+static void
+xfsm_manager_screensaver_active_changed (DBusGProxy  *proxy,
+                                         gboolean     active,
+                                         XfsmManager *manager)
+{
+  xfsm_verbose ("Screensaver is now %s\n", active ? "active" : "inactive");
+
+  manager->screensaver_active = active;
+
+  if (active)
+    xfsm_manager_freeze_clients (manager);
+  else
+    xfsm_manager_thaw_clients (manager);
+}
+
+
+static void
+xfsm_manager_screensaver_pid_cb (DBusGProxy     *proxy,
+                                 DBusGProxyCall *call,
+                                 gpointer        user_data)
+{
+  XfsmManager   *manager = XFSM_MANAGER (user_data);
+  GHashTableIter iter;
+  gpointer       pid;
+  GError        *error = NULL;
+  guint          screensaver_pid = 0;
+
+  if (!dbus_g_proxy_end_call (proxy, call, &error,
+                              G_TYPE_UINT, &screensaver_pid,
+                              G_TYPE_INVALID))
+    {
+      xfsm_verbose ("Failed to get the pid of the screensaver: %s\n",
+                    error->message);
+      g_error_free (error);
+      return;
+    }
+
+  xfsm_verbose ("Screensaver runs as pid %u\n", screensaver_pid);
+
+  manager->screensaver_pid = (GPid) screensaver_pid;
+
+  /* the screen got locked before we knew, don't leave the screensaver
+   * stopped */
+  g_hash_table_iter_init (&iter, manager->frozen_clients);
+  while (g_hash_table_iter_next (&iter, NULL, &pid))
+    {
+      if (GPOINTER_TO_INT (pid) == manager->screensaver_pid)
+        {
+          kill (manager->screensaver_pid, SIGCONT);
+          g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+
+/* the screensaver may well be a session client itself, so its pid is
+ * kept at hand for the moment the screen gets locked */
+static void
+xfsm_manager_query_screensaver_pid (XfsmManager *manager)
+{
+  dbus_g_proxy_begin_call (manager->bus_proxy,
+                           "GetConnectionUnixProcessID",
+                           xfsm_manager_screensaver_pid_cb,
+                           manager,
+                           NULL,
+                           G_TYPE_STRING, SCREENSAVER_NAME,
+                           G_TYPE_INVALID);
+}
+
+
+static void
+xfsm_manager_screensaver_owner_changed (DBusGProxy  *proxy,
+                                        const gchar *name,
+                                        const gchar *old_owner,
+                                        const gchar *new_owner,
+                                        XfsmManager *manager)
+{
+  if (strcmp (name, SCREENSAVER_NAME) != 0)
+    return;
+
+  manager->screensaver_pid = 0;
+
+  if (new_owner != NULL && *new_owner != '\0')
+    xfsm_manager_query_screensaver_pid (manager);
+}
+
+
+static void
+xfsm_manager_watch_screensaver (XfsmManager *manager)
+{
+  if (G_UNLIKELY (manager->session_bus == NULL))
+    return;
+
+  manager->bus_proxy = dbus_g_proxy_new_for_name (manager->session_bus,
+                                                  DBUS_SERVICE_DBUS,
+                                                  DBUS_PATH_DBUS,
+                                                  DBUS_INTERFACE_DBUS);
+
+  dbus_g_proxy_add_signal (manager->bus_proxy,
+                           "NameOwnerChanged",
+                           G_TYPE_STRING,
+                           G_TYPE_STRING,
+                           G_TYPE_STRING,
+                           G_TYPE_INVALID);
+
+  dbus_g_proxy_connect_signal (manager->bus_proxy,
+                               "NameOwnerChanged",
+                               G_CALLBACK (xfsm_manager_screensaver_owner_changed),
+                               manager, NULL);
+
+  /* the screensaver might be running already */
+  xfsm_manager_query_screensaver_pid (manager);
+
+  /* follows the name, so the screensaver can be started later on */
+  manager->screensaver_proxy = dbus_g_proxy_new_for_name (manager->session_bus,
+                                                          SCREENSAVER_NAME,
+                                                          SCREENSAVER_PATH,
+                                                          SCREENSAVER_INTERFACE);
+
+  dbus_g_proxy_add_signal (manager->screensaver_proxy,
+                           "ActiveChanged",
+                           G_TYPE_BOOLEAN,
+                           G_TYPE_INVALID);
+
+  dbus_g_proxy_connect_signal (manager->screensaver_proxy,
+                               "ActiveChanged",
+                               G_CALLBACK (xfsm_manager_screensaver_active_changed),
+                               manager, NULL);
+}
+
+
 XfsmShutdownType
 xfsm_manager_get_shutdown_type (XfsmManager *manager)
 {
@@ -1817,6 +3354,13 @@ xfsm_manager_get_start_at (XfsmManager *manager)
 }
 
 
+gboolean
+xfsm_manager_get_property_signals (XfsmManager *manager)
+{
+  return manager->property_signals;
+}
+
+
 /*
  * dbus server impl
  */
@@ -1836,6 +3380,10 @@ static gboolean xfsm_manager_dbus_list_clients (XfsmManager *manager,
 static gboolean xfsm_manager_dbus_get_state (XfsmManager *manager,
                                              guint       *OUT_state,
                                              GError     **error);
+static gboolean xfsm_manager_dbus_get_save_times (XfsmManager *manager,
+                                                  GHashTable **OUT_averages,
+                                                  GHashTable **OUT_timeouts,
+                                                  GError     **error);
 static gboolean xfsm_manager_dbus_checkpoint (XfsmManager *manager,
                                               const gchar *session_name,
                                               GError     **error);
@@ -1986,6 +3534,41 @@ xfsm_manager_dbus_get_state (XfsmManager *manager,
 }
 
 
+static gboolean
+xfsm_manager_dbus_get_save_times (XfsmManager *manager,
+                                  GHashTable **OUT_averages,
+                                  GHashTable **OUT_timeouts,
+                                  GError     **error)
+{
+  gchar **programs;
+  guint   average;
+  guint   timeout;
+  gint    n;
+
+  /* the maps own the program names, values are GUINT_TO_POINTER()ed */
+  *OUT_averages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  *OUT_timeouts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  programs = xfsm_save_stats_get_programs (manager->save_stats);
+  for (n = 0; programs[n] != NULL; ++n)
+    {
+      if (!xfsm_save_stats_lookup (manager->save_stats, programs[n], &average))
+        continue;
+
+      timeout = xfsm_save_stats_get_timeout (manager->save_stats, programs[n],
+                                             SAVE_TIMEOUT_MIN, SAVE_TIMEOUT);
+
+      g_hash_table_insert (*OUT_averages, g_strdup (programs[n]),
+                           GUINT_TO_POINTER (average));
+      g_hash_table_insert (*OUT_timeouts, g_strdup (programs[n]),
+                           GUINT_TO_POINTER (timeout));
+    }
+  g_strfreev (programs);
+
+  return TRUE;
+}
+
+
 static gboolean
 xfsm_manager_dbus_checkpoint_idled (gpointer data)
 {
@@ -42,6 +42,38 @@ G_BEGIN_DECLS
 #define SAVE_TIMEOUT           (    60 * 1000)
 #define STARTUP_TIMEOUT        (     8 * 1000)
 #define RESTART_RESET_TIMEOUT  (5 * 60 * 1000)
+#define DISCARD_TIMEOUT        (    30 * 1000)
+
+/* clients with a save history are disconnected when they take much
+ * longer than they used to, but get at least SAVE_TIMEOUT_MIN and at
+ * most SAVE_TIMEOUT; clients without one get SAVE_TIMEOUT */
+#define SAVE_TIMEOUT_MIN       (     5 * 1000)
+
+/* each priority group may use half of what is left of DIE_TIMEOUT,
+ * the last group all of it, but at least DIE_GROUP_TIMEOUT_MIN; local
+ * clients of the group still connected after two thirds of that get
+ * SIGTERM, and SIGKILL at its end, before the next group is sent
+ * SmsDie */
+#define DIE_GROUP_TIMEOUT_MIN  (     1 * 1000)
+
+/* a shutdown command gets SIGTERM after this, and SIGKILL 2 seconds
+ * later, which has to fit into the DIE_TIMEOUT */
+#define SHUTDOWN_COMMAND_TIMEOUT (   4 * 1000)
+
+/* number of discard commands that may run at the same time */
+#define DISCARD_MAX_RUNNING    2
+
+/* unless /general/SaveConcurrency says otherwise, one client per
+ * processor saves at a time, but never fewer than this */
+#define SAVE_CONCURRENCY_MIN   2
+
+/* shortest interval accepted for /general/PeriodicSaveInterval, in
+ * seconds; unlike /general/AutoSave this writes the running session */
+#define AUTOSAVE_MIN_INTERVAL  60
+
+/* delay before the live state file follows a change of the running
+ * clients, see xfsm_manager_live_state_changed() */
+#define LIVE_STATE_DELAY       (     1 * 1000)
 
 typedef enum
 {
@@ -140,8 +172,16 @@ gboolean xfsm_manager_run_command (XfsmManager          *manager,
                                    const XfsmProperties *properties,
                                    const gchar          *command);
 
+void xfsm_manager_run_discard_command (XfsmManager    *manager,
+                                       XfsmProperties *properties,
+                                       gchar         **discard_command);
+
 void xfsm_manager_store_session (XfsmManager *manager);
 
+void xfsm_manager_session_changed (XfsmManager *manager);
+
+void xfsm_manager_live_state_changed (XfsmManager *manager);
+
 void xfsm_manager_complete_saveyourself (XfsmManager *manager);
 
 XfsmShutdownType xfsm_manager_get_shutdown_type (XfsmManager *manager);
@@ -158,4 +198,6 @@ gboolean xfsm_manager_get_compat_startup (XfsmManager          *manager,
 
 gboolean xfsm_manager_get_start_at (XfsmManager *manager);
 
+gboolean xfsm_manager_get_property_signals (XfsmManager *manager);
+
 #endif /* !__XFSM_MANAGER_H__ */
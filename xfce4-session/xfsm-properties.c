@@ -36,7 +36,9 @@
 
 #include <libxfsm/xfsm-util.h>
 
+#include <xfce4-session/xfsm-deadline.h>
 #include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-intern.h>
 #include <xfce4-session/xfsm-properties.h>
 
 
@@ -81,12 +83,51 @@ static const struct
   const gchar *name;
   const gchar *xsmp_name;
   const guchar default_value;
+  const gboolean has_default;
 } uchar_properties[] = {
-  { "Priority", GsmPriority, 50 },
-  { "RestartStyleHint", SmRestartStyleHint, SmRestartIfRunning },
-  { NULL, NULL, 0 }
+  { "Priority", GsmPriority, 50, TRUE },
+  { "RestartStyleHint", SmRestartStyleHint, SmRestartIfRunning, TRUE },
+  /* only there if the client or the session file says so */
+  { "Stateless", XfsmStateless, 0, FALSE },
+  { NULL, NULL, 0, FALSE }
 };
 
+/* in the order of XfsmPropertyAtom */
+static const gchar *atom_names[XFSM_PROPERTY_N_ATOMS] =
+{
+  SmCloneCommand,
+  SmCurrentDirectory,
+  SmDiscardCommand,
+  SmEnvironment,
+  SmProcessID,
+  SmProgram,
+  SmResignCommand,
+  SmRestartCommand,
+  SmRestartStyleHint,
+  SmShutdownCommand,
+  SmUserID,
+  GsmPriority,
+  GsmDesktopFile,
+  XfsmStateless,
+};
+
+/* property name -> atom + 1 */
+static GHashTable *atom_table = NULL;
+
+/* session file key -> STORED_ENTRY (kind, index into the tables above),
+ * for xfsm_properties_load_session() */
+enum
+{
+  STORED_STRV = 1,
+  STORED_STR,
+  STORED_UCHAR,
+};
+#define STORED_ENTRY(kind, index) (GINT_TO_POINTER (((index) << 2) | (kind)))
+#define STORED_KIND(entry)        (GPOINTER_TO_INT (entry) & 3)
+#define STORED_INDEX(entry)       (GPOINTER_TO_INT (entry) >> 2)
+
+static GHashTable *stored_table = NULL;
+
 
 #ifndef HAVE_STRDUP
 static char*
@@ -189,59 +230,306 @@ xfsm_properties_new (const gchar *client_id,
   XfsmProperties *properties;
 
   properties = g_slice_new0 (XfsmProperties);
-  properties->client_id = g_strdup (client_id);
-  properties->hostname  = g_strdup (hostname);
+  properties->client_id = xfsm_intern (client_id);
+  properties->hostname  = xfsm_intern (hostname);
   properties->pid       = -1;
-
-  properties->sm_properties = g_tree_new_full ((GCompareDataFunc) strcmp,
-                                               NULL,
-                                               (GDestroyNotify) g_free,
-                                               (GDestroyNotify) xfsm_g_value_free);
+  properties->priority  = 50;
 
   return properties;
 }
 
 
-static gboolean
-xfsm_properties_extract_foreach (gpointer key,
-                                 gpointer value,
-                                 gpointer data)
+/**
+ * xfsm_properties_atom:
+ * @property_name : the name of an SM property.
+ *
+ * Return value: the #XfsmPropertyAtom of a well-known property,
+ *               or -1 if the property goes to the overflow table.
+ **/
+gint
+xfsm_properties_atom (const gchar *property_name)
 {
-  const gchar  *prop_name = key;
-  const GValue *prop_value = value;
-  SmProp     ***pp = data;
+  gint atom;
+
+  if (G_UNLIKELY (atom_table == NULL))
+    {
+      atom_table = g_hash_table_new (g_str_hash, g_str_equal);
+      for (atom = 0; atom < XFSM_PROPERTY_N_ATOMS; ++atom)
+        {
+          g_hash_table_insert (atom_table, (gpointer) atom_names[atom],
+                               GINT_TO_POINTER (atom + 1));
+        }
+    }
+
+  return GPOINTER_TO_INT (g_hash_table_lookup (atom_table, property_name)) - 1;
+}
+
+
+static GValue *
+xfsm_properties_lookup (const XfsmProperties *properties,
+                        const gchar          *property_name)
+{
+  const GValue *value;
+  gint          atom;
+
+  atom = xfsm_properties_atom (property_name);
+  if (G_LIKELY (atom >= 0))
+    {
+      value = &properties->atoms[atom];
+      return G_VALUE_TYPE (value) != G_TYPE_INVALID ? (GValue *) value : NULL;
+    }
+
+  if (properties->overflow == NULL)
+    return NULL;
+
+  return g_hash_table_lookup (properties->overflow, property_name);
+}
+
+
+/* the D-Bus table points to the values, so it only goes stale when
+ * a property is added or removed */
+static void
+xfsm_properties_keys_changed (XfsmProperties *properties)
+{
+  if (properties->dbus_props != NULL)
+    {
+      g_hash_table_unref (properties->dbus_props);
+      properties->dbus_props = NULL;
+    }
+}
+
+
+/* returns the value of the property, holding a @type */
+static GValue *
+xfsm_properties_ensure (XfsmProperties *properties,
+                        const gchar    *property_name,
+                        GType           type)
+{
+  GValue *value;
+  gint    atom;
+
+  atom = xfsm_properties_atom (property_name);
+  if (G_LIKELY (atom >= 0))
+    {
+      value = &properties->atoms[atom];
+    }
+  else
+    {
+      if (properties->overflow == NULL)
+        {
+          properties->overflow = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                        (GDestroyNotify) g_free,
+                                                        (GDestroyNotify) xfsm_g_value_free);
+        }
+
+      value = g_hash_table_lookup (properties->overflow, property_name);
+      if (value == NULL)
+        {
+          value = xfsm_g_value_new (type);
+          g_hash_table_insert (properties->overflow, g_strdup (property_name), value);
+          xfsm_properties_keys_changed (properties);
+          return value;
+        }
+    }
+
+  if (G_VALUE_TYPE (value) != type)
+    {
+      if (G_VALUE_TYPE (value) != G_TYPE_INVALID)
+        g_value_unset (value);
+      else
+        xfsm_properties_keys_changed (properties);
+      g_value_init (value, type);
+    }
+
+  return value;
+}
+
+
+/* call after the value of a property changed */
+static inline void
+xfsm_properties_changed (XfsmProperties *properties,
+                         const gchar    *property_name,
+                         const GValue   *value)
+{
+  if (properties->sm_props != NULL)
+    g_hash_table_remove (properties->sm_props, property_name);
+
+  if (value == &properties->atoms[XFSM_PROPERTY_PRIORITY])
+    {
+      properties->priority = G_VALUE_HOLDS_UCHAR (value)
+                             ? g_value_get_uchar (value) : 50;
+    }
+  else if (value == &properties->atoms[XFSM_PROPERTY_PROGRAM])
+    {
+      const gchar *program = NULL;
+
+      /* the slot borrows the pooled string, the reference is ours */
+      if (G_VALUE_HOLDS_STRING (value))
+        {
+          program = xfsm_intern (g_value_get_string (value));
+          g_value_set_static_string ((GValue *) value, program);
+        }
+
+      xfsm_unintern (properties->program);
+      properties->program = program;
+    }
+}
+
+
+/**
+ * xfsm_properties_foreach:
+ * @properties : an #XfsmProperties.
+ * @func       : the function to call for each property.
+ * @user_data  : data passed to @func.
+ *
+ * Calls @func for the well-known properties in the order of
+ * #XfsmPropertyAtom, then for all others.
+ **/
+void
+xfsm_properties_foreach (XfsmProperties    *properties,
+                         XfsmPropertiesFunc func,
+                         gpointer           user_data)
+{
+  GHashTableIter iter;
+  gpointer       key;
+  gpointer       value;
+  gint           atom;
+
+  g_return_if_fail (properties != NULL);
+  g_return_if_fail (func != NULL);
+
+  for (atom = 0; atom < XFSM_PROPERTY_N_ATOMS; ++atom)
+    if (G_VALUE_TYPE (&properties->atoms[atom]) != G_TYPE_INVALID)
+      func (atom_names[atom], &properties->atoms[atom], user_data);
+
+  if (properties->overflow != NULL)
+    {
+      g_hash_table_iter_init (&iter, properties->overflow);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        func (key, value, user_data);
+    }
+}
+
+
+typedef struct
+{
+  XfsmProperties *properties;
+  SmProp        **pp;
+} ExtractData;
+
+
+static void
+xfsm_properties_extract_foreach (const gchar  *prop_name,
+                                 const GValue *prop_value,
+                                 gpointer      data)
+{
+  ExtractData *edata = data;
+  SmProp      *prop;
+
+  /* serialized earlier and not changed since */
+  prop = g_hash_table_lookup (edata->properties->sm_props, prop_name);
+  if (prop != NULL)
+    {
+      *edata->pp++ = prop;
+      return;
+    }
 
   if (G_VALUE_HOLDS (prop_value, G_TYPE_STRV))
-    **pp++ = strv_to_property (prop_name, g_value_get_boxed (prop_value));
+    prop = strv_to_property (prop_name, g_value_get_boxed (prop_value));
   else if (G_VALUE_HOLDS_STRING (prop_value))
-    **pp++ = str_to_property (prop_name, g_value_get_string (prop_value));
+    prop = str_to_property (prop_name, g_value_get_string (prop_value));
   else if (G_VALUE_HOLDS_UCHAR (prop_value))
-    **pp++ = int_to_property (prop_name, g_value_get_uchar (prop_value));
+    prop = int_to_property (prop_name, g_value_get_uchar (prop_value));
   else {
     g_warning ("Unhandled property \"%s\" with type \"%s\"", prop_name,
                g_type_name (G_VALUE_TYPE (prop_value)));
+    return;
   }
 
-  return FALSE;
+  g_hash_table_insert (edata->properties->sm_props, g_strdup (prop_name), prop);
+  *edata->pp++ = prop;
 }
 
+/**
+ * xfsm_properties_extract:
+ * @properties : an #XfsmProperties.
+ * @num_props  : return location for the number of properties.
+ * @props      : return location for the properties.
+ *
+ * The SmProps are owned by @properties and are only converted again
+ * after their property changed. The caller frees the array with free()
+ * and must not keep it after changing @properties.
+ **/
 void
 xfsm_properties_extract (XfsmProperties *properties,
                          gint           *num_props,
                          SmProp       ***props)
 {
-  SmProp **pp;
+  ExtractData edata;
+  gint        n_props = 0;
+  gint        atom;
 
   g_return_if_fail (num_props != NULL);
   g_return_if_fail (props != NULL);
 
-  *props = pp = (SmProp **) malloc (sizeof (SmProp *) * g_tree_nnodes (properties->sm_properties));
+  for (atom = 0; atom < XFSM_PROPERTY_N_ATOMS; ++atom)
+    if (G_VALUE_TYPE (&properties->atoms[atom]) != G_TYPE_INVALID)
+      ++n_props;
+  if (properties->overflow != NULL)
+    n_props += g_hash_table_size (properties->overflow);
 
-  g_tree_foreach (properties->sm_properties,
-                  xfsm_properties_extract_foreach,
-                  &pp);
+  if (properties->sm_props == NULL)
+    {
+      properties->sm_props = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    (GDestroyNotify) g_free,
+                                                    (GDestroyNotify) SmFreeProperty);
+    }
+
+  *props = (SmProp **) malloc (sizeof (SmProp *) * n_props);
+
+  edata.properties = properties;
+  edata.pp = *props;
+  xfsm_properties_foreach (properties,
+                           xfsm_properties_extract_foreach,
+                           &edata);
+
+  *num_props = edata.pp - *props;
+}
+
+
+static void
+xfsm_properties_dbus_foreach (const gchar  *prop_name,
+                              const GValue *prop_value,
+                              gpointer      data)
+{
+  g_hash_table_insert (data, (gpointer) prop_name, (gpointer) prop_value);
+}
+
+
+/**
+ * xfsm_properties_get_table:
+ * @properties : an #XfsmProperties.
+ *
+ * Returns all properties as a table from name to #GValue, ready to be
+ * sent over D-Bus as a{sv}. The table is kept until a property is
+ * added or removed, the values are those of @properties.
+ *
+ * Return value: a new reference to the table.
+ **/
+GHashTable *
+xfsm_properties_get_table (XfsmProperties *properties)
+{
+  g_return_val_if_fail (properties != NULL, NULL);
+
+  if (properties->dbus_props == NULL)
+    {
+      properties->dbus_props = g_hash_table_new (g_str_hash, g_str_equal);
+      xfsm_properties_foreach (properties,
+                               xfsm_properties_dbus_foreach,
+                               properties->dbus_props);
+    }
 
-  *num_props = pp - *props;
+  return g_hash_table_ref (properties->dbus_props);
 }
 
 
@@ -288,11 +576,9 @@ xfsm_properties_load (XfceRc      *rc,
         {
           xfsm_verbose ("-> Set strv (%s)\n", strv_properties[i].xsmp_name);
           /* don't use _set_strv() to avoid a realloc of the whole strv */
-          value = xfsm_g_value_new (G_TYPE_STRV);
+          value = xfsm_properties_ensure (properties, strv_properties[i].xsmp_name,
+                                          G_TYPE_STRV);
           g_value_take_boxed (value, value_strv);
-          g_tree_replace (properties->sm_properties,
-                          g_strdup (strv_properties[i].xsmp_name),
-                          value);
         }
     }
 
@@ -305,6 +591,10 @@ xfsm_properties_load (XfceRc      *rc,
 
   for (i = 0; uchar_properties[i].name; ++i)
     {
+      if (!uchar_properties[i].has_default
+          && !xfce_rc_has_entry (rc, ENTRY (uchar_properties[i].name)))
+        continue;
+
       value_int = xfce_rc_read_int_entry (rc, ENTRY (uchar_properties[i].name),
                                           uchar_properties[i].default_value);
       xfsm_properties_set_uchar (properties, uchar_properties[i].xsmp_name, value_int);
@@ -322,51 +612,404 @@ xfsm_properties_load (XfceRc      *rc,
 }
 
 
+typedef struct
+{
+  gint            index;
+  guint           lineno;     /* first entry of the client */
+  XfsmProperties *properties;
+} XfsmLoadClient;
+
+
+static void
+xfsm_load_client_free (XfsmLoadClient *lclient)
+{
+  if (lclient->properties != NULL)
+    xfsm_properties_free (lclient->properties);
+  g_slice_free (XfsmLoadClient, lclient);
+}
+
+
+static gint
+xfsm_load_client_compare (gconstpointer a,
+                          gconstpointer b)
+{
+  const XfsmLoadClient *ca = *(const XfsmLoadClient **) a;
+  const XfsmLoadClient *cb = *(const XfsmLoadClient **) b;
+
+  /* highest index first, like the Count loop did */
+  return cb->index - ca->index;
+}
+
+
+/* undoes the escaping of xfce_rc_write_entry() in place */
+static void
+xfsm_properties_unescape (gchar *value)
+{
+  gchar *p;
+  gchar *q;
+
+  for (p = q = value; *p != '\0'; ++p, ++q)
+    {
+      if (p[0] == '\\' && p[1] != '\0')
+        {
+          switch (*++p)
+            {
+            case 'n':  *q = '\n'; break;
+            case 't':  *q = '\t'; break;
+            case 'r':  *q = '\r'; break;
+            case ' ':  *q = ' ';  break;
+            case '\\': *q = '\\'; break;
+            default:   *q++ = '\\'; *q = *p; break;
+            }
+        }
+      else
+        {
+          *q = *p;
+        }
+    }
+
+  *q = '\0';
+}
+
+
+static void
+xfsm_properties_load_entry (XfsmProperties *properties,
+                            const gchar    *filename,
+                            guint           lineno,
+                            const gchar    *name,
+                            gchar          *value)
+{
+  gpointer  entry;
+  GValue   *gvalue;
+  gchar    *end;
+  glong     value_int;
+  gint      i;
+
+  if (strcmp (name, "ClientId") == 0)
+    {
+      xfsm_unintern (properties->client_id);
+      properties->client_id = xfsm_intern (value);
+      return;
+    }
+  else if (strcmp (name, "Hostname") == 0)
+    {
+      xfsm_unintern (properties->hostname);
+      properties->hostname = xfsm_intern (value);
+      return;
+    }
+
+  entry = g_hash_table_lookup (stored_table, name);
+  if (entry == NULL)
+    {
+      /* e.g. the ProcessId of the live state */
+      xfsm_verbose ("%s:%u: ignoring unknown key %s\n", filename, lineno, name);
+      return;
+    }
+
+  i = STORED_INDEX (entry);
+  switch (STORED_KIND (entry))
+    {
+    case STORED_STRV:
+      xfsm_verbose ("-> Set strv (%s)\n", strv_properties[i].xsmp_name);
+      /* same encoding as xfce_rc_write_list_entry() */
+      gvalue = xfsm_properties_ensure (properties, strv_properties[i].xsmp_name,
+                                       G_TYPE_STRV);
+      g_value_take_boxed (gvalue, g_strsplit (value, ";", -1));
+      xfsm_properties_changed (properties, strv_properties[i].xsmp_name, gvalue);
+      break;
+
+    case STORED_STR:
+      xfsm_properties_set_string (properties, str_properties[i].xsmp_name, value);
+      break;
+
+    case STORED_UCHAR:
+      value_int = strtol (value, &end, 10);
+      if (end == value || *end != '\0')
+        {
+          g_warning ("%s:%u: %s is not a number, using the default",
+                     filename, lineno, name);
+          break;
+        }
+      xfsm_properties_set_uchar (properties, uchar_properties[i].xsmp_name, value_int);
+      break;
+    }
+}
+
+
+/**
+ * xfsm_properties_load_session:
+ * @filename     : the session file.
+ * @session_name : the session to load.
+ *
+ * Loads the stored clients of a session in a single pass over the
+ * session file.  Every ClientN_Key line goes straight to client N,
+ * instead of looking up each known key of each client in an #XfceRc.
+ * Broken lines and clients are reported with their line number and
+ * skipped.
+ *
+ * Return value: the #XfsmProperties of the valid clients, highest
+ *               client number first.
+ **/
+GList *
+xfsm_properties_load_session (const gchar *filename,
+                              const gchar *session_name)
+{
+  XfsmLoadClient *lclient;
+  GHashTableIter  iter;
+  GHashTable     *clients;
+  GPtrArray      *sorted;
+  GError         *error = NULL;
+  GList          *result = NULL;
+  gchar          *contents;
+  gchar          *group;
+  gchar          *line;
+  gchar          *end;
+  gchar          *key;
+  gchar          *value;
+  gchar          *p;
+  gboolean        in_group = FALSE;
+  guint           lineno = 0;
+  glong           count = 0;
+  glong           n;
+  guint           i;
+  guint           j;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (session_name != NULL, NULL);
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_warning ("Unable to read session file %s: %s", filename, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  if (G_UNLIKELY (stored_table == NULL))
+    {
+      stored_table = g_hash_table_new (g_str_hash, g_str_equal);
+      for (i = 0; strv_properties[i].name; ++i)
+        g_hash_table_insert (stored_table, (gpointer) strv_properties[i].name,
+                             STORED_ENTRY (STORED_STRV, i));
+      for (i = 0; str_properties[i].name; ++i)
+        g_hash_table_insert (stored_table, (gpointer) str_properties[i].name,
+                             STORED_ENTRY (STORED_STR, i));
+      for (i = 0; uchar_properties[i].name; ++i)
+        g_hash_table_insert (stored_table, (gpointer) uchar_properties[i].name,
+                             STORED_ENTRY (STORED_UCHAR, i));
+    }
+
+  group = g_strconcat ("Session: ", session_name, NULL);
+  clients = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                   (GDestroyNotify) xfsm_load_client_free);
+
+  for (line = contents; line != NULL && *line != '\0'; line = end)
+    {
+      end = strchr (line, '\n');
+      if (end != NULL)
+        *end++ = '\0';
+      ++lineno;
+
+      line = g_strstrip (line);
+      if (*line == '\0' || *line == '#')
+        continue;
+
+      if (*line == '[')
+        {
+          p = strchr (line, ']');
+          if (p == NULL)
+            {
+              g_warning ("%s:%u: unterminated group name", filename, lineno);
+              in_group = FALSE;
+              continue;
+            }
+
+          *p = '\0';
+          in_group = (strcmp (line + 1, group) == 0);
+          continue;
+        }
+
+      if (!in_group)
+        continue;
+
+      p = strchr (line, '=');
+      if (p == NULL)
+        {
+          g_warning ("%s:%u: expected \"key=value\", line ignored", filename, lineno);
+          continue;
+        }
+
+      *p = '\0';
+      key = g_strchomp (line);
+      value = g_strchug (p + 1);
+      xfsm_properties_unescape (value);
+
+      if (strcmp (key, "Count") == 0)
+        {
+          count = strtol (value, &p, 10);
+          if (p == value || *p != '\0' || count < 0)
+            {
+              g_warning ("%s:%u: invalid client count", filename, lineno);
+              count = 0;
+            }
+          continue;
+        }
+
+      /* session wide entries, legacy clients etc. */
+      if (strncmp (key, "Client", 6) != 0)
+        continue;
+
+      n = strtol (key + 6, &p, 10);
+      if (p == key + 6 || *p != '_' || n < 0 || n > G_MAXINT)
+        {
+          g_warning ("%s:%u: malformed client key %s, line ignored",
+                     filename, lineno, key);
+          continue;
+        }
+
+      lclient = g_hash_table_lookup (clients, GINT_TO_POINTER (n));
+      if (lclient == NULL)
+        {
+          lclient = g_slice_new (XfsmLoadClient);
+          lclient->index = n;
+          lclient->lineno = lineno;
+          lclient->properties = xfsm_properties_new (NULL, NULL);
+          g_hash_table_insert (clients, GINT_TO_POINTER (n), lclient);
+        }
+
+      xfsm_properties_load_entry (lclient->properties, filename, lineno,
+                                  p + 1, value);
+    }
+
+  /* same order as the old Count loop */
+  sorted = g_ptr_array_sized_new (g_hash_table_size (clients));
+  g_hash_table_iter_init (&iter, clients);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) &lclient))
+    g_ptr_array_add (sorted, lclient);
+  g_ptr_array_sort (sorted, xfsm_load_client_compare);
+
+  for (i = 0; i < sorted->len; ++i)
+    {
+      XfsmProperties *properties;
+
+      lclient = g_ptr_array_index (sorted, i);
+      properties = lclient->properties;
+
+      if (lclient->index >= count)
+        {
+          xfsm_verbose ("%s:%u: Client%d_ is beyond the client count, skipping\n",
+                        filename, lclient->lineno, lclient->index);
+          continue;
+        }
+
+      if (properties->client_id == NULL || properties->hostname == NULL)
+        {
+          g_warning ("%s:%u: Session data broken, stored client is missing "
+                     "a %s. Skipping client.", filename, lclient->lineno,
+                     properties->client_id == NULL ? "client id" : "hostname");
+          continue;
+        }
+
+      xfsm_verbose ("Loaded properties for client %s\n", properties->client_id);
+
+      /* like xfce_rc_read_int_entry() with a default */
+      for (j = 0; uchar_properties[j].name; ++j)
+        {
+          if (uchar_properties[j].has_default
+              && xfsm_properties_get (properties, uchar_properties[j].xsmp_name) == NULL)
+            {
+              xfsm_properties_set_uchar (properties, uchar_properties[j].xsmp_name,
+                                         uchar_properties[j].default_value);
+            }
+        }
+
+      if (!xfsm_properties_check (properties))
+        {
+          g_warning ("%s:%u: Client%d_ has no program or restart command. "
+                     "Skipping client.", filename, lclient->lineno, lclient->index);
+          continue;
+        }
+
+      /* the list owns them from now on */
+      result = g_list_prepend (result, properties);
+      lclient->properties = NULL;
+    }
+
+  g_ptr_array_free (sorted, TRUE);
+  g_hash_table_destroy (clients);
+  g_free (group);
+  g_free (contents);
+
+  return g_list_reverse (result);
+}
+
+
 void
 xfsm_properties_store (XfsmProperties *properties,
-                       XfceRc         *rc,
-                       const gchar    *prefix)
+                       XfsmSnapshot   *snapshot)
 {
-#define ENTRY(name) (compose(buffer, 256, prefix, (name)))
+  XfsmSnapshotClient *client;
+  GValue             *value;
+  gchar              *list;
+  gchar               buffer[32];
+  gint                i;
 
-  GValue *value;
-  gint    i;
-  gchar   buffer[256];
+  client = xfsm_snapshot_add_client (snapshot, properties->client_id);
 
-  xfce_rc_write_entry (rc, ENTRY ("ClientId"), properties->client_id);
-  xfce_rc_write_entry (rc, ENTRY ("Hostname"), properties->hostname);
+  xfsm_snapshot_client_write_entry (client, "ClientId", properties->client_id);
+  xfsm_snapshot_client_write_entry (client, "Hostname", properties->hostname);
 
   for (i = 0; strv_properties[i].name; ++i)
     {
-      value = g_tree_lookup (properties->sm_properties, strv_properties[i].xsmp_name);
+      value = xfsm_properties_lookup (properties, strv_properties[i].xsmp_name);
       if (value)
         {
-          xfce_rc_write_list_entry (rc, ENTRY (strv_properties[i].name),
-                                    g_value_get_boxed (value), NULL);
+          /* same encoding as xfce_rc_write_list_entry() */
+          list = g_strjoinv (";", g_value_get_boxed (value));
+          xfsm_snapshot_client_write_entry (client, strv_properties[i].name, list);
+          g_free (list);
         }
     }
 
   for (i = 0; str_properties[i].name; ++i)
     {
-      value = g_tree_lookup (properties->sm_properties, str_properties[i].xsmp_name);
+      value = xfsm_properties_lookup (properties, str_properties[i].xsmp_name);
       if (value)
         {
-          xfce_rc_write_entry (rc, ENTRY (str_properties[i].name),
-                               g_value_get_string (value));
+          xfsm_snapshot_client_write_entry (client, str_properties[i].name,
+                                            g_value_get_string (value));
         }
     }
 
   for (i = 0; uchar_properties[i].name; ++i)
     {
-      value = g_tree_lookup (properties->sm_properties, uchar_properties[i].xsmp_name);
+      value = xfsm_properties_lookup (properties, uchar_properties[i].xsmp_name);
       if (value)
         {
-          xfce_rc_write_int_entry (rc, ENTRY (uchar_properties[i].name),
-                                   g_value_get_uchar (value));
+          g_snprintf (buffer, 32, "%d", g_value_get_uchar (value));
+          xfsm_snapshot_client_write_entry (client, uchar_properties[i].name, buffer);
         }
     }
+}
 
-#undef ENTRY
+
+gboolean
+xfsm_properties_is_stored (const gchar *property_name)
+{
+  gint i;
+
+  for (i = 0; strv_properties[i].name; ++i)
+    if (strcmp (strv_properties[i].xsmp_name, property_name) == 0)
+      return TRUE;
+
+  for (i = 0; str_properties[i].name; ++i)
+    if (strcmp (str_properties[i].xsmp_name, property_name) == 0)
+      return TRUE;
+
+  for (i = 0; uchar_properties[i].name; ++i)
+    if (strcmp (uchar_properties[i].xsmp_name, property_name) == 0)
+      return TRUE;
+
+  return FALSE;
 }
 
 
@@ -374,18 +1017,7 @@ gint
 xfsm_properties_compare (const XfsmProperties *a,
                          const XfsmProperties *b)
 {
-  GValue *va, *vb;
-  gint ia = 50, ib = 50;
-
-  va = g_tree_lookup (a->sm_properties, GsmPriority);
-  if (va)
-    ia = g_value_get_uchar (va);
-
-  vb = g_tree_lookup (b->sm_properties, GsmPriority);
-  if (vb)
-    ib = g_value_get_uchar (vb);
-
-  return ia - ib;
+  return (gint) a->priority - (gint) b->priority;
 }
 
 
@@ -393,7 +1025,7 @@ gint
 xfsm_properties_compare_id (const XfsmProperties *properties,
                             const gchar *client_id)
 {
-  return strcmp (properties->client_id, client_id);
+  return properties->client_id == client_id ? 0 : 1;
 }
 
 
@@ -404,8 +1036,8 @@ xfsm_properties_check (const XfsmProperties *properties)
 
   return properties->client_id != NULL
     && properties->hostname != NULL
-    && g_tree_lookup (properties->sm_properties, SmProgram) != NULL
-    && g_tree_lookup (properties->sm_properties, SmRestartCommand) != NULL;
+    && G_VALUE_TYPE (&properties->atoms[XFSM_PROPERTY_PROGRAM]) != G_TYPE_INVALID
+    && G_VALUE_TYPE (&properties->atoms[XFSM_PROPERTY_RESTART_COMMAND]) != G_TYPE_INVALID;
 }
 
 
@@ -418,7 +1050,7 @@ xfsm_properties_get_string (XfsmProperties *properties,
   g_return_val_if_fail (properties != NULL, NULL);
   g_return_val_if_fail (property_name != NULL, NULL);
 
-  value = g_tree_lookup (properties->sm_properties, property_name);
+  value = xfsm_properties_lookup (properties, property_name);
 
   if (G_LIKELY (value && G_VALUE_HOLDS_STRING (value)))
     return g_value_get_string (value);
@@ -436,7 +1068,7 @@ xfsm_properties_get_strv (XfsmProperties *properties,
   g_return_val_if_fail (properties != NULL, NULL);
   g_return_val_if_fail (property_name != NULL, NULL);
 
-  value = g_tree_lookup (properties->sm_properties, property_name);
+  value = xfsm_properties_lookup (properties, property_name);
 
   if (G_LIKELY (value && G_VALUE_HOLDS (value, G_TYPE_STRV)))
     return g_value_get_boxed (value);
@@ -455,7 +1087,7 @@ xfsm_properties_get_uchar (XfsmProperties *properties,
   g_return_val_if_fail (properties != NULL, default_value);
   g_return_val_if_fail (property_name != NULL, default_value);
 
-  value = g_tree_lookup (properties->sm_properties, property_name);
+  value = xfsm_properties_lookup (properties, property_name);
 
   if (G_LIKELY (value && G_VALUE_HOLDS_UCHAR (value)))
     return g_value_get_uchar (value);
@@ -471,7 +1103,7 @@ xfsm_properties_get (XfsmProperties *properties,
   g_return_val_if_fail (properties != NULL, NULL);
   g_return_val_if_fail (property_name != NULL, NULL);
 
-  return g_tree_lookup (properties->sm_properties, property_name);
+  return xfsm_properties_lookup (properties, property_name);
 }
 
 
@@ -488,24 +1120,9 @@ xfsm_properties_set_string (XfsmProperties *properties,
 
   xfsm_verbose ("-> Set string (%s, %s)\n", property_name, property_value);
 
-  value = g_tree_lookup (properties->sm_properties, property_name);
-  if (value)
-    {
-      if (!G_VALUE_HOLDS_STRING (value))
-        {
-          g_value_unset (value);
-          g_value_init (value, G_TYPE_STRING);
-        }
-      g_value_set_string (value, property_value);
-    }
-  else
-    {
-      value = xfsm_g_value_new (G_TYPE_STRING);
-      g_value_set_string (value, property_value);
-      g_tree_replace (properties->sm_properties,
-                      g_strdup (property_name),
-                      value);
-    }
+  value = xfsm_properties_ensure (properties, property_name, G_TYPE_STRING);
+  g_value_set_string (value, property_value);
+  xfsm_properties_changed (properties, property_name, value);
 }
 
 
@@ -522,24 +1139,9 @@ xfsm_properties_set_strv (XfsmProperties *properties,
 
   xfsm_verbose ("-> Set strv (%s)\n", property_name);
 
-  value = g_tree_lookup (properties->sm_properties, property_name);
-  if (value)
-    {
-      if (!G_VALUE_HOLDS (value, G_TYPE_STRV))
-        {
-          g_value_unset (value);
-          g_value_init (value, G_TYPE_STRV);
-        }
-      g_value_set_boxed (value, property_value);
-    }
-  else
-    {
-      value = xfsm_g_value_new (G_TYPE_STRV);
-      g_value_set_boxed (value, property_value);
-      g_tree_replace (properties->sm_properties,
-                      g_strdup (property_name),
-                      value);
-    }
+  value = xfsm_properties_ensure (properties, property_name, G_TYPE_STRV);
+  g_value_set_boxed (value, property_value);
+  xfsm_properties_changed (properties, property_name, value);
 }
 
 void
@@ -554,24 +1156,9 @@ xfsm_properties_set_uchar (XfsmProperties *properties,
 
   xfsm_verbose ("-> Set uchar (%s, %d)\n", property_name, property_value);
 
-  value = g_tree_lookup (properties->sm_properties, property_name);
-  if (value)
-    {
-      if (!G_VALUE_HOLDS_UCHAR (value))
-        {
-          g_value_unset (value);
-          g_value_init (value, G_TYPE_UCHAR);
-        }
-      g_value_set_uchar (value, property_value);
-    }
-  else
-    {
-      value = xfsm_g_value_new (G_TYPE_UCHAR);
-      g_value_set_uchar (value, property_value);
-      g_tree_replace (properties->sm_properties,
-                      g_strdup (property_name),
-                      value);
-    }
+  value = xfsm_properties_ensure (properties, property_name, G_TYPE_UCHAR);
+  g_value_set_uchar (value, property_value);
+  xfsm_properties_changed (properties, property_name, value);
 }
 
 
@@ -597,10 +1184,10 @@ xfsm_properties_set (XfsmProperties *properties,
 
   xfsm_verbose ("-> Set (%s)\n", property_name);
 
-  new_value = xfsm_g_value_new (G_VALUE_TYPE (property_value));
+  new_value = xfsm_properties_ensure (properties, property_name,
+                                      G_VALUE_TYPE (property_value));
   g_value_copy (property_value, new_value);
-
-  g_tree_replace (properties->sm_properties, g_strdup (property_name), new_value);
+  xfsm_properties_changed (properties, property_name, new_value);
 
   return TRUE;
 }
@@ -629,24 +1216,9 @@ xfsm_properties_set_from_smprop (XfsmProperties *properties,
       xfsm_verbose ("-> Set strv (%s)\n", sm_prop->name);
 
       /* don't use _set_strv() to avoid a realloc of the whole strv */
-      value = g_tree_lookup (properties->sm_properties, sm_prop->name);
-      if (value)
-        {
-          if (!G_VALUE_HOLDS (value, G_TYPE_STRV))
-            {
-              g_value_unset (value);
-              g_value_init (value, G_TYPE_STRV);
-            }
-          g_value_take_boxed (value, value_strv);
-        }
-      else
-        {
-          value = xfsm_g_value_new (G_TYPE_STRV);
-          g_value_take_boxed (value, value_strv);
-          g_tree_replace (properties->sm_properties,
-                          g_strdup (sm_prop->name),
-                          value);
-        }
+      value = xfsm_properties_ensure (properties, sm_prop->name, G_TYPE_STRV);
+      g_value_take_boxed (value, value_strv);
+      xfsm_properties_changed (properties, sm_prop->name, value);
     }
   else if (!strcmp (sm_prop->type, SmARRAY8))
     {
@@ -674,12 +1246,42 @@ gboolean
 xfsm_properties_remove (XfsmProperties *properties,
                         const gchar *property_name)
 {
+  gint atom;
+
   g_return_val_if_fail (properties != NULL, FALSE);
   g_return_val_if_fail (property_name != NULL, FALSE);
 
   xfsm_verbose ("-> Removing (%s)\n", property_name);
 
-  return g_tree_remove (properties->sm_properties, property_name);
+  atom = xfsm_properties_atom (property_name);
+  if (G_LIKELY (atom >= 0))
+    {
+      if (G_VALUE_TYPE (&properties->atoms[atom]) == G_TYPE_INVALID)
+        return FALSE;
+
+      /* leaves the slot zeroed, that is unset */
+      g_value_unset (&properties->atoms[atom]);
+    }
+  else if (properties->overflow == NULL
+           || !g_hash_table_remove (properties->overflow, property_name))
+    {
+      return FALSE;
+    }
+
+  if (atom == XFSM_PROPERTY_PRIORITY)
+    properties->priority = 50;
+  else if (atom == XFSM_PROPERTY_PROGRAM)
+    {
+      xfsm_unintern (properties->program);
+      properties->program = NULL;
+    }
+
+  if (properties->sm_props != NULL)
+    g_hash_table_remove (properties->sm_props, property_name);
+
+  xfsm_properties_keys_changed (properties);
+
+  return TRUE;
 }
 
 
@@ -706,21 +1308,31 @@ xfsm_properties_set_default_child_watch (XfsmProperties *properties)
 void
 xfsm_properties_free (XfsmProperties *properties)
 {
+  gint atom;
+
   g_return_if_fail (properties != NULL);
 
   xfsm_properties_set_default_child_watch (properties);
 
   if (properties->restart_attempts_reset_id > 0)
-    g_source_remove (properties->restart_attempts_reset_id);
+    xfsm_deadline_remove (properties->restart_attempts_reset_id);
   if (properties->startup_timeout_id > 0)
-    g_source_remove (properties->startup_timeout_id);
-
-  if (properties->client_id != NULL)
-    g_free (properties->client_id);
-  if (properties->hostname != NULL)
-    g_free (properties->hostname);
-
-  g_tree_destroy (properties->sm_properties);
+    xfsm_deadline_remove (properties->startup_timeout_id);
+
+  xfsm_unintern (properties->client_id);
+  xfsm_unintern (properties->hostname);
+
+  for (atom = 0; atom < XFSM_PROPERTY_N_ATOMS; ++atom)
+    if (G_VALUE_TYPE (&properties->atoms[atom]) != G_TYPE_INVALID)
+      g_value_unset (&properties->atoms[atom]);
+  xfsm_unintern (properties->program);
+
+  if (properties->overflow != NULL)
+    g_hash_table_destroy (properties->overflow);
+  if (properties->sm_props != NULL)
+    g_hash_table_destroy (properties->sm_props);
+  if (properties->dbus_props != NULL)
+    g_hash_table_unref (properties->dbus_props);
 
   g_slice_free (XfsmProperties, properties);
 }
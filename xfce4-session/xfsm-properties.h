@@ -26,14 +26,44 @@
 
 #include <libxfce4util/libxfce4util.h>
 
+#include <xfce4-session/xfsm-snapshot.h>
+
 /* GNOME compatibility */
 #define GsmPriority     "_GSM_Priority"
 #define GsmDesktopFile  "_GSM_DesktopFile"
 
+/* CARD8, non-zero if the client holds no state worth a SaveYourself */
+#define XfsmStateless   "_XFSM_Stateless"
+
 #define MAX_RESTART_ATTEMPTS 5
 
+/* the well-known XSMP and GSM properties get a fixed slot each in
+ * XfsmProperties, see xfsm_properties_atom() */
+typedef enum
+{
+  XFSM_PROPERTY_CLONE_COMMAND = 0,
+  XFSM_PROPERTY_CURRENT_DIRECTORY,
+  XFSM_PROPERTY_DISCARD_COMMAND,
+  XFSM_PROPERTY_ENVIRONMENT,
+  XFSM_PROPERTY_PROCESS_ID,
+  XFSM_PROPERTY_PROGRAM,
+  XFSM_PROPERTY_RESIGN_COMMAND,
+  XFSM_PROPERTY_RESTART_COMMAND,
+  XFSM_PROPERTY_RESTART_STYLE_HINT,
+  XFSM_PROPERTY_SHUTDOWN_COMMAND,
+  XFSM_PROPERTY_USER_ID,
+  XFSM_PROPERTY_PRIORITY,
+  XFSM_PROPERTY_DESKTOP_FILE,
+  XFSM_PROPERTY_STATELESS,
+  XFSM_PROPERTY_N_ATOMS
+} XfsmPropertyAtom;
+
 typedef struct _XfsmProperties XfsmProperties;
 
+typedef void (*XfsmPropertiesFunc) (const gchar  *property_name,
+                                    const GValue *property_value,
+                                    gpointer      user_data);
+
 struct _XfsmProperties
 {
   guint   restart_attempts;
@@ -44,10 +74,24 @@ struct _XfsmProperties
   GPid    pid;
   guint   child_watch_id;
 
-  gchar  *client_id;
-  gchar  *hostname;
+  /* interned, see xfsm-intern.h */
+  const gchar *client_id;
+  const gchar *hostname;
+  const gchar *program;   /* reference held for the Program slot */
+
+  /* _GSM_Priority, kept up to date by the setters */
+  guchar  priority;
 
-  GTree  *sm_properties;
+  /* unset slots hold G_TYPE_INVALID */
+  GValue      atoms[XFSM_PROPERTY_N_ATOMS];
+
+  /* property name -> GValue for everything else, NULL if empty */
+  GHashTable *overflow;
+
+  /* serialized forms, built on demand and dropped when the
+   * properties change, NULL if nobody asked yet */
+  GHashTable *sm_props;     /* property name -> SmProp */
+  GHashTable *dbus_props;   /* property name -> GValue */
 };
 
 
@@ -62,13 +106,20 @@ void            xfsm_properties_extract (XfsmProperties *properties,
                                          gint           *num_props,
                                          SmProp       ***props);
 void            xfsm_properties_store   (XfsmProperties *properties,
-                                         XfceRc         *rc,
-                                         const gchar    *prefix);
+                                         XfsmSnapshot   *snapshot);
+GHashTable     *xfsm_properties_get_table (XfsmProperties *properties);
 
 XfsmProperties* xfsm_properties_load (XfceRc *rc, const gchar *prefix);
+GList          *xfsm_properties_load_session (const gchar *filename,
+                                              const gchar *session_name);
 
 gboolean xfsm_properties_check (const XfsmProperties *properties) G_GNUC_CONST;
 
+gint xfsm_properties_atom (const gchar *property_name);
+
+/* whether the property ends up in the session file */
+gboolean xfsm_properties_is_stored (const gchar *property_name) G_GNUC_PURE;
+
 const gchar *xfsm_properties_get_string (XfsmProperties *properties,
                                                   const gchar *property_name);
 gchar **xfsm_properties_get_strv (XfsmProperties *properties,
@@ -80,6 +131,10 @@ guchar xfsm_properties_get_uchar (XfsmProperties *properties,
 const GValue *xfsm_properties_get (XfsmProperties *properties,
                                    const gchar *property_name);
 
+void xfsm_properties_foreach (XfsmProperties    *properties,
+                              XfsmPropertiesFunc func,
+                              gpointer           user_data);
+
 void xfsm_properties_set_string (XfsmProperties *properties,
                                  const gchar *property_name,
                                  const gchar *property_value);
@@ -104,6 +159,7 @@ void xfsm_properties_set_default_child_watch (XfsmProperties *properties);
 gint xfsm_properties_compare (const XfsmProperties *a,
                               const XfsmProperties *b) G_GNUC_CONST;
 
+/* @client_id has to be interned, see xfsm_intern_lookup() */
 gint xfsm_properties_compare_id (const XfsmProperties *properties,
                                  const gchar *client_id);
 
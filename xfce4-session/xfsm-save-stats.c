@@ -0,0 +1,343 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_TIME_H
+#include <time.h>
+#endif
+
+#include <glib.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-save-stats.h>
+
+
+typedef struct _XfsmSaveRecord XfsmSaveRecord;
+
+struct _XfsmSaveRecord
+{
+  guint n_samples;
+  guint average;    /* msec, moving average */
+  guint deviation;  /* msec, moving mean deviation from the average */
+  gint  last_saved; /* time () of the last sample */
+};
+
+
+/* group name prefix in the stats file */
+#define XFSM_SAVE_STATS_GROUP "Program: "
+
+/* samples needed before the history is trusted for a timeout */
+#define XFSM_SAVE_STATS_MIN_SAMPLES 3
+
+/* programs not seen saving for this long are dropped from the file */
+#define XFSM_SAVE_STATS_MAX_AGE (90 * 24 * 60 * 60)
+
+struct _XfsmSaveStats
+{
+  GHashTable *records;
+};
+
+
+
+XfsmSaveStats*
+xfsm_save_stats_new (void)
+{
+  XfsmSaveStats *stats;
+
+  stats = g_slice_new0 (XfsmSaveStats);
+  stats->records = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  return stats;
+}
+
+
+
+void
+xfsm_save_stats_free (XfsmSaveStats *stats)
+{
+  if (G_UNLIKELY (stats == NULL))
+    return;
+
+  g_hash_table_destroy (stats->records);
+  g_slice_free (XfsmSaveStats, stats);
+}
+
+
+
+/**
+ * xfsm_save_stats_add:
+ * @stats   : an #XfsmSaveStats.
+ * @program : the program the client runs.
+ * @msec    : the time the client needed to save.
+ *
+ * Adds a sample to the average of @program.  Newer samples weigh more,
+ * so a program that got faster or slower is noticed after a few saves.
+ * Same estimator as the TCP retransmission timer (RFC 6298).
+ **/
+void
+xfsm_save_stats_add (XfsmSaveStats *stats,
+                     const gchar   *program,
+                     guint          msec)
+{
+  XfsmSaveRecord *record;
+  guint           delta;
+
+  g_return_if_fail (stats != NULL);
+  g_return_if_fail (program != NULL);
+
+  record = g_hash_table_lookup (stats->records, program);
+  if (record == NULL)
+    {
+      record = g_new0 (XfsmSaveRecord, 1);
+      g_hash_table_insert (stats->records, g_strdup (program), record);
+    }
+
+  if (record->n_samples == 0)
+    {
+      record->average = msec;
+      record->deviation = msec / 2;
+    }
+  else
+    {
+      delta = msec > record->average ? msec - record->average : record->average - msec;
+      record->deviation = (3 * (guint64) record->deviation + delta) / 4;
+      record->average = (7 * (guint64) record->average + msec) / 8;
+    }
+
+  if (record->n_samples < G_MAXUINT)
+    record->n_samples++;
+  record->last_saved = time (NULL);
+
+  xfsm_verbose ("Program %s saved in %u ms, average %u ms, deviation %u ms\n",
+                program, msec, record->average, record->deviation);
+}
+
+
+
+gboolean
+xfsm_save_stats_lookup (XfsmSaveStats *stats,
+                        const gchar   *program,
+                        guint         *average_return)
+{
+  XfsmSaveRecord *record;
+
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  if (program == NULL)
+    return FALSE;
+
+  record = g_hash_table_lookup (stats->records, program);
+  if (record == NULL)
+    return FALSE;
+
+  if (average_return != NULL)
+    *average_return = record->average;
+
+  return TRUE;
+}
+
+
+
+/**
+ * xfsm_save_stats_get_timeout:
+ * @stats       : an #XfsmSaveStats.
+ * @program     : the program the client runs, or %NULL.
+ * @min_timeout : the shortest timeout to return, msec.
+ * @max_timeout : the longest timeout to return, msec.
+ *
+ * Return value: how long to wait for @program to finish saving, which
+ *               is @max_timeout until there is enough history.
+ **/
+guint
+xfsm_save_stats_get_timeout (XfsmSaveStats *stats,
+                             const gchar   *program,
+                             guint          min_timeout,
+                             guint          max_timeout)
+{
+  XfsmSaveRecord *record;
+  guint64         timeout;
+
+  g_return_val_if_fail (stats != NULL, max_timeout);
+
+  if (program == NULL)
+    return max_timeout;
+
+  record = g_hash_table_lookup (stats->records, program);
+  if (record == NULL || record->n_samples < XFSM_SAVE_STATS_MIN_SAMPLES)
+    return max_timeout;
+
+  timeout = (guint64) record->average + 4 * (guint64) record->deviation;
+
+  return CLAMP (timeout, min_timeout, max_timeout);
+}
+
+
+
+/**
+ * xfsm_save_stats_get_programs:
+ * @stats : an #XfsmSaveStats.
+ *
+ * Return value: the programs with a history, free with g_strfreev().
+ **/
+gchar**
+xfsm_save_stats_get_programs (XfsmSaveStats *stats)
+{
+  GHashTableIter  iter;
+  gpointer        program;
+  gchar         **programs;
+  guint           n = 0;
+
+  g_return_val_if_fail (stats != NULL, NULL);
+
+  programs = g_new (gchar *, g_hash_table_size (stats->records) + 1);
+
+  g_hash_table_iter_init (&iter, stats->records);
+  while (g_hash_table_iter_next (&iter, &program, NULL))
+    programs[n++] = g_strdup (program);
+  programs[n] = NULL;
+
+  return programs;
+}
+
+
+
+void
+xfsm_save_stats_load (XfsmSaveStats *stats,
+                      const gchar   *filename)
+{
+  XfsmSaveRecord *record;
+  XfceRc         *rc;
+  gchar         **groups;
+  const gchar    *program;
+  gint            now = time (NULL);
+  gint            n;
+
+  g_return_if_fail (stats != NULL);
+  g_return_if_fail (filename != NULL);
+
+  rc = xfce_rc_simple_open (filename, TRUE);
+  if (rc == NULL)
+    return;
+
+  groups = xfce_rc_get_groups (rc);
+  for (n = 0; groups != NULL && groups[n] != NULL; ++n)
+    {
+      if (strncmp (groups[n], XFSM_SAVE_STATS_GROUP, strlen (XFSM_SAVE_STATS_GROUP)) != 0)
+        continue;
+
+      program = groups[n] + strlen (XFSM_SAVE_STATS_GROUP);
+      if (*program == '\0')
+        continue;
+
+      xfce_rc_set_group (rc, groups[n]);
+
+      record = g_new0 (XfsmSaveRecord, 1);
+      record->n_samples = MAX (xfce_rc_read_int_entry (rc, "Samples", 0), 0);
+      record->average = MAX (xfce_rc_read_int_entry (rc, "Average", 0), 0);
+      record->deviation = MAX (xfce_rc_read_int_entry (rc, "Deviation", 0), 0);
+      /* files written before LastSaved existed start the clock now */
+      record->last_saved = xfce_rc_read_int_entry (rc, "LastSaved", now);
+
+      g_hash_table_replace (stats->records, g_strdup (program), record);
+    }
+
+  g_strfreev (groups);
+  xfce_rc_close (rc);
+
+  xfsm_verbose ("Loaded save times of %u programs from %s\n",
+                g_hash_table_size (stats->records), filename);
+}
+
+
+
+void
+xfsm_save_stats_store (XfsmSaveStats *stats,
+                       const gchar   *filename)
+{
+  GHashTableIter  iter;
+  XfsmSaveRecord *record;
+  gpointer        program;
+  XfceRc         *rc;
+  gchar         **groups;
+  gchar          *group;
+  gchar          *path;
+  gint            now = time (NULL);
+  gint            n;
+
+  g_return_if_fail (stats != NULL);
+  g_return_if_fail (filename != NULL);
+
+  rc = xfce_rc_simple_open (filename, FALSE);
+  if (G_UNLIKELY (rc == NULL))
+    {
+      g_warning ("Unable to open %s for writing", filename);
+      return;
+    }
+
+  /* the file is rewritten from the table, so programs dropped below
+   * do not linger in it */
+  groups = xfce_rc_get_groups (rc);
+  for (n = 0; groups != NULL && groups[n] != NULL; ++n)
+    if (strncmp (groups[n], XFSM_SAVE_STATS_GROUP, strlen (XFSM_SAVE_STATS_GROUP)) == 0)
+      xfce_rc_delete_group (rc, groups[n], FALSE);
+  g_strfreev (groups);
+
+  g_hash_table_iter_init (&iter, stats->records);
+  while (g_hash_table_iter_next (&iter, &program, (gpointer) &record))
+    {
+      /* forget programs that were uninstalled or not used for months */
+      if (now - record->last_saved > XFSM_SAVE_STATS_MAX_AGE)
+        {
+          xfsm_verbose ("Dropping save times of %s, not seen since %d\n",
+                        (const gchar *) program, record->last_saved);
+          g_hash_table_iter_remove (&iter);
+          continue;
+        }
+
+      path = g_find_program_in_path (program);
+      if (path == NULL)
+        {
+          xfsm_verbose ("Dropping save times of %s, no longer installed\n",
+                        (const gchar *) program);
+          g_hash_table_iter_remove (&iter);
+          continue;
+        }
+      g_free (path);
+
+      group = g_strconcat (XFSM_SAVE_STATS_GROUP, program, NULL);
+      xfce_rc_set_group (rc, group);
+      xfce_rc_write_int_entry (rc, "Samples", MIN (record->n_samples, G_MAXINT));
+      xfce_rc_write_int_entry (rc, "Average", MIN (record->average, G_MAXINT));
+      xfce_rc_write_int_entry (rc, "Deviation", MIN (record->deviation, G_MAXINT));
+      xfce_rc_write_int_entry (rc, "LastSaved", record->last_saved);
+      g_free (group);
+    }
+
+  xfce_rc_close (rc);
+}
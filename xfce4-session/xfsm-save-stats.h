@@ -0,0 +1,60 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef __XFSM_SAVE_STATS_H__
+#define __XFSM_SAVE_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Remembers how long clients took from SaveYourself to SaveYourselfDone,
+ * per program and across sessions, so the manager can hand out the save
+ * slots of a checkpoint or logout to the fast clients first, and give
+ * each client a save timeout that matches its history.
+ */
+
+typedef struct _XfsmSaveStats XfsmSaveStats;
+
+XfsmSaveStats *xfsm_save_stats_new          (void);
+void           xfsm_save_stats_free         (XfsmSaveStats *stats);
+
+void           xfsm_save_stats_add          (XfsmSaveStats *stats,
+                                             const gchar   *program,
+                                             guint          msec);
+gboolean       xfsm_save_stats_lookup       (XfsmSaveStats *stats,
+                                             const gchar   *program,
+                                             guint         *average_return);
+
+guint          xfsm_save_stats_get_timeout  (XfsmSaveStats *stats,
+                                             const gchar   *program,
+                                             guint          min_timeout,
+                                             guint          max_timeout);
+gchar        **xfsm_save_stats_get_programs (XfsmSaveStats *stats);
+
+void           xfsm_save_stats_load         (XfsmSaveStats *stats,
+                                             const gchar   *filename);
+void           xfsm_save_stats_store        (XfsmSaveStats *stats,
+                                             const gchar   *filename);
+
+G_END_DECLS
+
+#endif /* !__XFSM_SAVE_STATS_H__ */
@@ -0,0 +1,593 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <xfce4-session/xfsm-global.h>
+#include <xfce4-session/xfsm-snapshot.h>
+
+
+static XfsmSnapshotEntry*
+xfsm_snapshot_entry_new (const gchar *key,
+                         const gchar *value)
+{
+  XfsmSnapshotEntry *entry;
+
+  entry = g_slice_new (XfsmSnapshotEntry);
+  entry->key = g_strdup (key);
+  entry->value = g_strdup (value);
+
+  return entry;
+}
+
+
+
+static void
+xfsm_snapshot_entry_free (XfsmSnapshotEntry *entry)
+{
+  g_free (entry->key);
+  g_free (entry->value);
+  g_slice_free (XfsmSnapshotEntry, entry);
+}
+
+
+
+static XfsmSnapshotEntry*
+xfsm_snapshot_entries_lookup (GPtrArray   *entries,
+                              const gchar *key,
+                              guint       *index_return)
+{
+  XfsmSnapshotEntry *entry;
+  guint              n;
+
+  for (n = 0; n < entries->len; ++n)
+    {
+      entry = g_ptr_array_index (entries, n);
+      if (strcmp (entry->key, key) == 0)
+        {
+          if (index_return != NULL)
+            *index_return = n;
+          return entry;
+        }
+    }
+
+  return NULL;
+}
+
+
+
+static void
+xfsm_snapshot_client_free (XfsmSnapshotClient *client)
+{
+  g_ptr_array_foreach (client->entries, (GFunc) xfsm_snapshot_entry_free, NULL);
+  g_ptr_array_free (client->entries, TRUE);
+  g_free (client->client_id);
+  g_slice_free (XfsmSnapshotClient, client);
+}
+
+
+
+XfsmSnapshot*
+xfsm_snapshot_new (const gchar *session_name)
+{
+  XfsmSnapshot *snapshot;
+
+  g_return_val_if_fail (session_name != NULL, NULL);
+
+  snapshot = g_slice_new0 (XfsmSnapshot);
+  snapshot->session_name = g_strdup (session_name);
+  snapshot->clients = g_ptr_array_new ();
+  snapshot->client_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  snapshot->entries = g_ptr_array_new ();
+
+  return snapshot;
+}
+
+
+
+void
+xfsm_snapshot_free (XfsmSnapshot *snapshot)
+{
+  if (G_UNLIKELY (snapshot == NULL))
+    return;
+
+  xfsm_snapshot_clear (snapshot);
+
+  g_ptr_array_free (snapshot->clients, TRUE);
+  g_hash_table_destroy (snapshot->client_ids);
+  g_ptr_array_free (snapshot->entries, TRUE);
+  g_free (snapshot->session_name);
+
+  g_slice_free (XfsmSnapshot, snapshot);
+}
+
+
+
+/**
+ * xfsm_snapshot_clear:
+ * @snapshot : an #XfsmSnapshot.
+ *
+ * Drops all clients and session wide entries.
+ **/
+void
+xfsm_snapshot_clear (XfsmSnapshot *snapshot)
+{
+  g_return_if_fail (snapshot != NULL);
+
+  g_hash_table_remove_all (snapshot->client_ids);
+
+  g_ptr_array_foreach (snapshot->clients, (GFunc) xfsm_snapshot_client_free, NULL);
+  g_ptr_array_set_size (snapshot->clients, 0);
+
+  g_ptr_array_foreach (snapshot->entries, (GFunc) xfsm_snapshot_entry_free, NULL);
+  g_ptr_array_set_size (snapshot->entries, 0);
+}
+
+
+
+/**
+ * xfsm_snapshot_add_client:
+ * @snapshot  : an #XfsmSnapshot.
+ * @client_id : the id of the client.
+ *
+ * Adds an empty client to the end of @snapshot, replacing an existing
+ * client with the same id.
+ *
+ * Return value: the new client, owned by @snapshot.
+ **/
+XfsmSnapshotClient*
+xfsm_snapshot_add_client (XfsmSnapshot *snapshot,
+                          const gchar  *client_id)
+{
+  XfsmSnapshotClient *client;
+
+  g_return_val_if_fail (snapshot != NULL, NULL);
+  g_return_val_if_fail (client_id != NULL, NULL);
+
+  xfsm_snapshot_remove_client (snapshot, client_id);
+
+  client = g_slice_new (XfsmSnapshotClient);
+  client->client_id = g_strdup (client_id);
+  client->entries = g_ptr_array_new ();
+
+  g_ptr_array_add (snapshot->clients, client);
+  g_hash_table_insert (snapshot->client_ids, client->client_id, client);
+
+  return client;
+}
+
+
+
+XfsmSnapshotClient*
+xfsm_snapshot_lookup_client (const XfsmSnapshot *snapshot,
+                             const gchar        *client_id)
+{
+  g_return_val_if_fail (snapshot != NULL, NULL);
+  g_return_val_if_fail (client_id != NULL, NULL);
+
+  return g_hash_table_lookup (snapshot->client_ids, client_id);
+}
+
+
+
+void
+xfsm_snapshot_remove_client (XfsmSnapshot *snapshot,
+                             const gchar  *client_id)
+{
+  XfsmSnapshotClient *client;
+
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (client_id != NULL);
+
+  client = g_hash_table_lookup (snapshot->client_ids, client_id);
+  if (client == NULL)
+    return;
+
+  g_hash_table_remove (snapshot->client_ids, client_id);
+  g_ptr_array_remove (snapshot->clients, client);
+  xfsm_snapshot_client_free (client);
+}
+
+
+
+void
+xfsm_snapshot_client_write_entry (XfsmSnapshotClient *client,
+                                  const gchar        *key,
+                                  const gchar        *value)
+{
+  XfsmSnapshotEntry *entry;
+
+  g_return_if_fail (client != NULL);
+  g_return_if_fail (key != NULL && value != NULL);
+
+  entry = xfsm_snapshot_entries_lookup (client->entries, key, NULL);
+  if (entry != NULL)
+    {
+      g_free (entry->value);
+      entry->value = g_strdup (value);
+    }
+  else
+    {
+      g_ptr_array_add (client->entries, xfsm_snapshot_entry_new (key, value));
+    }
+}
+
+
+
+/**
+ * xfsm_snapshot_client_equal:
+ * @a : an #XfsmSnapshotClient.
+ * @b : another #XfsmSnapshotClient.
+ *
+ * Return value: %TRUE if @a and @b have the same entries in the same
+ *               order.
+ **/
+gboolean
+xfsm_snapshot_client_equal (const XfsmSnapshotClient *a,
+                            const XfsmSnapshotClient *b)
+{
+  XfsmSnapshotEntry *ea;
+  XfsmSnapshotEntry *eb;
+  guint              n;
+
+  if (a->entries->len != b->entries->len)
+    return FALSE;
+
+  for (n = 0; n < a->entries->len; ++n)
+    {
+      ea = g_ptr_array_index (a->entries, n);
+      eb = g_ptr_array_index (b->entries, n);
+
+      if (strcmp (ea->key, eb->key) != 0 || strcmp (ea->value, eb->value) != 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+void
+xfsm_snapshot_write_entry (XfsmSnapshot *snapshot,
+                           const gchar  *key,
+                           const gchar  *value)
+{
+  XfsmSnapshotEntry *entry;
+
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (key != NULL && value != NULL);
+
+  entry = xfsm_snapshot_entries_lookup (snapshot->entries, key, NULL);
+  if (entry != NULL)
+    {
+      g_free (entry->value);
+      entry->value = g_strdup (value);
+    }
+  else
+    {
+      g_ptr_array_add (snapshot->entries, xfsm_snapshot_entry_new (key, value));
+    }
+}
+
+
+
+void
+xfsm_snapshot_write_int_entry (XfsmSnapshot *snapshot,
+                               const gchar  *key,
+                               gint          value)
+{
+  gchar buffer[32];
+
+  g_snprintf (buffer, 32, "%d", value);
+  xfsm_snapshot_write_entry (snapshot, key, buffer);
+}
+
+
+
+void
+xfsm_snapshot_write_list_entry (XfsmSnapshot *snapshot,
+                                const gchar  *key,
+                                gchar       **value)
+{
+  gchar *list;
+
+  /* same encoding as xfce_rc_write_list_entry() */
+  list = g_strjoinv (";", value);
+  xfsm_snapshot_write_entry (snapshot, key, list);
+  g_free (list);
+}
+
+
+
+const gchar*
+xfsm_snapshot_read_entry (const XfsmSnapshot *snapshot,
+                          const gchar        *key)
+{
+  XfsmSnapshotEntry *entry;
+
+  g_return_val_if_fail (snapshot != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  entry = xfsm_snapshot_entries_lookup (snapshot->entries, key, NULL);
+
+  return entry != NULL ? entry->value : NULL;
+}
+
+
+
+void
+xfsm_snapshot_delete_entry (XfsmSnapshot *snapshot,
+                            const gchar  *key)
+{
+  XfsmSnapshotEntry *entry;
+  guint              n;
+
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (key != NULL);
+
+  entry = xfsm_snapshot_entries_lookup (snapshot->entries, key, &n);
+  if (entry != NULL)
+    {
+      g_ptr_array_remove_index (snapshot->entries, n);
+      xfsm_snapshot_entry_free (entry);
+    }
+}
+
+
+
+static gint
+xfsm_snapshot_parse_client_key (const gchar  *key,
+                                const gchar **name_return)
+{
+  gchar *end;
+  glong  n;
+
+  if (strncmp (key, "Client", 6) != 0)
+    return -1;
+
+  n = strtol (key + 6, &end, 10);
+  if (end == key + 6 || *end != '_' || n < 0 || n > G_MAXINT)
+    return -1;
+
+  *name_return = end + 1;
+
+  return n;
+}
+
+
+
+typedef struct
+{
+  gint       index;
+  GPtrArray *entries;
+} XfsmSnapshotRcClient;
+
+
+
+static gint
+xfsm_snapshot_rc_client_compare (gconstpointer a,
+                                 gconstpointer b)
+{
+  const XfsmSnapshotRcClient *client_a = *(XfsmSnapshotRcClient * const *) a;
+  const XfsmSnapshotRcClient *client_b = *(XfsmSnapshotRcClient * const *) b;
+
+  return client_a->index < client_b->index ? -1 : client_a->index > client_b->index;
+}
+
+
+
+/**
+ * xfsm_snapshot_load_rc:
+ * @rc           : an #XfceRc.
+ * @session_name : the session to read.
+ *
+ * Reads the "Session: @session_name" group of @rc.  Clients without
+ * a client id are skipped, as are the clients at or beyond the "Count"
+ * of the group, like xfsm_properties_load_session() does.
+ *
+ * Return value: a new #XfsmSnapshot, empty if the group does not exist.
+ **/
+XfsmSnapshot*
+xfsm_snapshot_load_rc (XfceRc      *rc,
+                       const gchar *session_name)
+{
+  XfsmSnapshotRcClient *rc_client;
+  XfsmSnapshotClient   *client;
+  XfsmSnapshot         *snapshot;
+  GHashTableIter        iter;
+  GHashTable           *clients;
+  GPtrArray            *sorted;
+  GPtrArray            *entries;
+  const gchar          *value;
+  const gchar          *name;
+  gchar               **keys;
+  gchar                *group;
+  gchar                *end;
+  glong                 count;
+  gint                  n;
+  guint                 i;
+  guint                 m;
+
+  g_return_val_if_fail (rc != NULL, NULL);
+  g_return_val_if_fail (session_name != NULL, NULL);
+
+  snapshot = xfsm_snapshot_new (session_name);
+
+  group = g_strconcat ("Session: ", session_name, NULL);
+  if (!xfce_rc_has_group (rc, group))
+    {
+      g_free (group);
+      return snapshot;
+    }
+
+  keys = xfce_rc_get_entries (rc, group);
+  xfce_rc_set_group (rc, group);
+  g_free (group);
+
+  if (G_UNLIKELY (keys == NULL))
+    return snapshot;
+
+  value = xfce_rc_read_entry_untranslated (rc, "Count", NULL);
+  count = value != NULL ? strtol (value, &end, 10) : 0;
+  if (value != NULL && (end == value || *end != '\0' || count < 0))
+    count = 0;
+
+  /* ClientN_ entries by N, which is whatever the file says, so no
+   * array indexed by it */
+  clients = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; keys[i] != NULL; ++i)
+    {
+      value = xfce_rc_read_entry_untranslated (rc, keys[i], NULL);
+      if (value == NULL || strcmp (keys[i], "Count") == 0)
+        continue;
+
+      n = xfsm_snapshot_parse_client_key (keys[i], &name);
+      if (n < 0)
+        {
+          xfsm_snapshot_write_entry (snapshot, keys[i], value);
+          continue;
+        }
+
+      rc_client = g_hash_table_lookup (clients, GINT_TO_POINTER (n));
+      if (rc_client == NULL)
+        {
+          rc_client = g_slice_new (XfsmSnapshotRcClient);
+          rc_client->index = n;
+          rc_client->entries = g_ptr_array_new ();
+          g_hash_table_insert (clients, GINT_TO_POINTER (n), rc_client);
+        }
+
+      g_ptr_array_add (rc_client->entries, xfsm_snapshot_entry_new (name, value));
+    }
+
+  /* in the order of N */
+  sorted = g_ptr_array_sized_new (g_hash_table_size (clients));
+  g_hash_table_iter_init (&iter, clients);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) &rc_client))
+    g_ptr_array_add (sorted, rc_client);
+  g_ptr_array_sort (sorted, xfsm_snapshot_rc_client_compare);
+
+  for (i = 0; i < sorted->len; ++i)
+    {
+      rc_client = g_ptr_array_index (sorted, i);
+      entries = rc_client->entries;
+      n = rc_client->index;
+      g_slice_free (XfsmSnapshotRcClient, rc_client);
+
+      if (n >= count)
+        {
+          xfsm_verbose ("Client%d is beyond the client count, skipping\n", n);
+          g_ptr_array_foreach (entries, (GFunc) xfsm_snapshot_entry_free, NULL);
+          g_ptr_array_free (entries, TRUE);
+          continue;
+        }
+
+      value = NULL;
+      for (m = 0; m < entries->len; ++m)
+        {
+          XfsmSnapshotEntry *entry = g_ptr_array_index (entries, m);
+          if (strcmp (entry->key, "ClientId") == 0)
+            value = entry->value;
+        }
+
+      if (value != NULL)
+        {
+          client = xfsm_snapshot_add_client (snapshot, value);
+
+          /* hand the entries over */
+          g_ptr_array_free (client->entries, TRUE);
+          client->entries = entries;
+        }
+      else
+        {
+          xfsm_verbose ("Client%d has no client id, skipping\n", n);
+          g_ptr_array_foreach (entries, (GFunc) xfsm_snapshot_entry_free, NULL);
+          g_ptr_array_free (entries, TRUE);
+        }
+    }
+
+  g_ptr_array_free (sorted, TRUE);
+  g_hash_table_destroy (clients);
+  g_strfreev (keys);
+
+  return snapshot;
+}
+
+
+
+/**
+ * xfsm_snapshot_store_rc:
+ * @snapshot : an #XfsmSnapshot.
+ * @rc       : an #XfceRc opened for writing.
+ *
+ * Replaces the "Session: <name>" group of @rc with the content of
+ * @snapshot.
+ **/
+void
+xfsm_snapshot_store_rc (const XfsmSnapshot *snapshot,
+                        XfceRc             *rc)
+{
+  XfsmSnapshotClient *client;
+  XfsmSnapshotEntry  *entry;
+  gchar               buffer[256];
+  gchar              *group;
+  guint               n;
+  guint               m;
+
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (rc != NULL);
+
+  group = g_strconcat ("Session: ", snapshot->session_name, NULL);
+  xfce_rc_delete_group (rc, group, TRUE);
+  xfce_rc_set_group (rc, group);
+  g_free (group);
+
+  for (n = 0; n < snapshot->clients->len; ++n)
+    {
+      client = g_ptr_array_index (snapshot->clients, n);
+      for (m = 0; m < client->entries->len; ++m)
+        {
+          entry = g_ptr_array_index (client->entries, m);
+          g_snprintf (buffer, 256, "Client%u_%s", n, entry->key);
+          xfce_rc_write_entry (rc, buffer, entry->value);
+        }
+    }
+
+  xfce_rc_write_int_entry (rc, "Count", snapshot->clients->len);
+
+  for (n = 0; n < snapshot->entries->len; ++n)
+    {
+      entry = g_ptr_array_index (snapshot->entries, n);
+      xfce_rc_write_entry (rc, entry->key, entry->value);
+    }
+}
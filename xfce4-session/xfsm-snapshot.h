@@ -0,0 +1,101 @@
+/* $Id$ */
+/*-
+ * Copyright (c) 2026 The Xfce development team
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef __XFSM_SNAPSHOT_H__
+#define __XFSM_SNAPSHOT_H__
+
+#include <glib.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+G_BEGIN_DECLS
+
+/* An XfsmSnapshot is the content of one "Session: <name>" group of the
+ * session file, as plain strings: the entries of every client, keyed
+ * by client id, and the session wide entries (legacy clients, active
+ * workspaces, LastAccess).  The "Count" and "ClientN_" bookkeeping of
+ * the rc format is generated when the snapshot is written to an rc.
+ */
+
+typedef struct _XfsmSnapshot       XfsmSnapshot;
+typedef struct _XfsmSnapshotClient XfsmSnapshotClient;
+typedef struct _XfsmSnapshotEntry  XfsmSnapshotEntry;
+
+struct _XfsmSnapshotEntry
+{
+  gchar *key;
+  gchar *value;
+};
+
+struct _XfsmSnapshotClient
+{
+  gchar     *client_id;
+  GPtrArray *entries;      /* XfsmSnapshotEntry, in store order */
+};
+
+struct _XfsmSnapshot
+{
+  gchar      *session_name;
+  GPtrArray  *clients;     /* XfsmSnapshotClient, in store order */
+  GHashTable *client_ids;  /* client id -> XfsmSnapshotClient */
+  GPtrArray  *entries;     /* session wide XfsmSnapshotEntry */
+};
+
+XfsmSnapshot       *xfsm_snapshot_new             (const gchar        *session_name);
+void                xfsm_snapshot_free            (XfsmSnapshot       *snapshot);
+
+void                xfsm_snapshot_clear           (XfsmSnapshot       *snapshot);
+
+XfsmSnapshotClient *xfsm_snapshot_add_client      (XfsmSnapshot       *snapshot,
+                                                   const gchar        *client_id);
+XfsmSnapshotClient *xfsm_snapshot_lookup_client   (const XfsmSnapshot *snapshot,
+                                                   const gchar        *client_id);
+void                xfsm_snapshot_remove_client   (XfsmSnapshot       *snapshot,
+                                                   const gchar        *client_id);
+
+void                xfsm_snapshot_client_write_entry (XfsmSnapshotClient *client,
+                                                      const gchar        *key,
+                                                      const gchar        *value);
+gboolean            xfsm_snapshot_client_equal       (const XfsmSnapshotClient *a,
+                                                      const XfsmSnapshotClient *b);
+
+void                xfsm_snapshot_write_entry      (XfsmSnapshot       *snapshot,
+                                                    const gchar        *key,
+                                                    const gchar        *value);
+void                xfsm_snapshot_write_int_entry  (XfsmSnapshot       *snapshot,
+                                                    const gchar        *key,
+                                                    gint                value);
+void                xfsm_snapshot_write_list_entry (XfsmSnapshot       *snapshot,
+                                                    const gchar        *key,
+                                                    gchar             **value);
+const gchar        *xfsm_snapshot_read_entry       (const XfsmSnapshot *snapshot,
+                                                    const gchar        *key);
+void                xfsm_snapshot_delete_entry     (XfsmSnapshot       *snapshot,
+                                                    const gchar        *key);
+
+XfsmSnapshot       *xfsm_snapshot_load_rc          (XfceRc             *rc,
+                                                    const gchar        *session_name);
+void                xfsm_snapshot_store_rc         (const XfsmSnapshot *snapshot,
+                                                    XfceRc             *rc);
+
+G_END_DECLS
+
+#endif /* !__XFSM_SNAPSHOT_H__ */
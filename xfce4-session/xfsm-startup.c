@@ -27,6 +27,9 @@
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
 #ifdef HAVE_MEMORY_H
 #include <memory.h>
 #endif
@@ -60,6 +63,7 @@
 
 #include <xfce4-session/xfsm-compat-gnome.h>
 #include <xfce4-session/xfsm-compat-kde.h>
+#include <xfce4-session/xfsm-deadline.h>
 #include <xfce4-session/xfsm-global.h>
 #include <xfce4-session/xfsm-manager.h>
 #include <xfce4-session/xfsm-splash-screen.h>
@@ -371,15 +375,62 @@ xfsm_startup_shutdown (void)
 
 
 
+/* resident set size in KiB, -1 if unknown */
+static glong
+xfsm_startup_get_rss (void)
+{
+  gchar *contents;
+  glong  size;
+  glong  resident = -1;
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    return -1;
+
+  if (sscanf (contents, "%ld %ld", &size, &resident) == 2)
+    resident *= sysconf (_SC_PAGESIZE) / 1024;
+  else
+    resident = -1;
+
+  g_free (contents);
+
+  return resident;
+}
+
+
+
+/* the rest of the session has no use for the memory we needed to
+ * start it, so give it back once the splash screen is done */
 static gboolean
-destroy_splash (gpointer user_data)
+xfsm_startup_reclaim (gpointer user_data)
 {
+  glong rss_before;
+  glong rss_after;
+
+  rss_before = xfsm_startup_get_rss ();
+
+  /* unloads the engine module, with its pixbufs and windows */
   if (G_LIKELY (splash_screen != NULL))
     {
       xfsm_splash_screen_free (splash_screen);
       splash_screen = NULL;
     }
 
+  /* let the server drop the pixmaps of the splash windows now */
+  gdk_flush ();
+
+#ifdef HAVE_MALLOC_TRIM
+  /* startup freed a lot of small blocks, hand the pages back */
+  malloc_trim (0);
+#endif
+
+  rss_after = xfsm_startup_get_rss ();
+
+  if (rss_before >= 0 && rss_after >= 0)
+    {
+      g_message ("Startup finished, resident memory %ld KiB, %ld KiB "
+                 "reclaimed", rss_after, rss_before - rss_after);
+    }
+
   return FALSE;
 }
 
@@ -749,11 +800,11 @@ xfsm_startup_autostart (XfsmManager *manager)
       if (G_LIKELY (splash_screen != NULL))
         xfsm_splash_screen_next (splash_screen, _("Performing Autostart..."));
 
-      g_timeout_add (2000, destroy_splash, NULL);
+      g_timeout_add_seconds (2, xfsm_startup_reclaim, NULL);
     }
   else
     {
-      g_timeout_add (1000, destroy_splash, NULL);
+      g_timeout_add_seconds (1, xfsm_startup_reclaim, NULL);
     }
 }
 
@@ -986,11 +1037,10 @@ xfsm_startup_start_properties (XfsmProperties *properties,
   startup_timeout_data = g_new (XfsmStartupData, 1);
   startup_timeout_data->manager = g_object_ref (manager);
   startup_timeout_data->properties = properties;
-  properties->startup_timeout_id = g_timeout_add_full (G_PRIORITY_DEFAULT,
-                                                       STARTUP_TIMEOUT,
-                                                       xfsm_startup_timeout,
-                                                       startup_timeout_data,
-                                                       (GDestroyNotify) xfsm_startup_data_free);
+  properties->startup_timeout_id = xfsm_deadline_add_full (STARTUP_TIMEOUT,
+                                                           xfsm_startup_timeout,
+                                                           startup_timeout_data,
+                                                           (GDestroyNotify) xfsm_startup_data_free);
 
   return TRUE;
 }
@@ -1035,14 +1085,14 @@ xfsm_startup_session_next_prio_group (XfsmManager *manager)
   if (properties == NULL)
     return FALSE;
 
-  cur_prio_group = xfsm_properties_get_uchar (properties, GsmPriority, 50);
+  cur_prio_group = properties->priority;
 
   xfsm_verbose ("Starting apps in prio group %d\n", cur_prio_group);
 
   while ((properties = g_queue_pop_head (pending_properties)))
     {
       /* quit if we've hit all the clients in the current prio group */
-      if (xfsm_properties_get_uchar (properties, GsmPriority, 50) != cur_prio_group)
+      if (properties->priority != cur_prio_group)
         {
           /* we're not starting this one yet; put it back */
           g_queue_push_head (pending_properties, properties);
@@ -1164,7 +1214,7 @@ xfsm_startup_handle_failed_startup (XfsmProperties *properties,
   /* if our timer hasn't run out yet, kill it */
   if (properties->startup_timeout_id > 0)
     {
-      g_source_remove (properties->startup_timeout_id);
+      xfsm_deadline_remove (properties->startup_timeout_id);
       properties->startup_timeout_id = 0;
     }
 